@@ -1,7 +1,11 @@
 #pragma once
+#include <atomic>
+#include <exception>
+#include <thread>
 #include "surakarta_agent_base.h"
 #include "surakarta_alphazero_mcts.h"
 #include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_time_control.h"
 #include "surakarta_daemon.h"
 
 class SurakartaAgentAlphazero : public SurakartaAgentBase {
@@ -13,16 +17,43 @@ class SurakartaAgentAlphazero : public SurakartaAgentBase {
                             std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
                             int simulation_per_move,
                             float cpuct,
-                            float temperature)
+                            float temperature,
+                            int search_threads = 1,
+                            size_t transposition_table_size = 0,
+                            const SurakartaAlphazeroTimeControl& time_control = SurakartaAlphazeroTimeControl(),
+                            int ponder_simulations = 0)
         : SurakartaAgentBase(board, game_info, rule_manager),
           model_(model),
           my_color_(my_color),
           simulation_per_move_(simulation_per_move),
           cpuct_(cpuct),
-          temperature_(temperature){};
+          temperature_(temperature),
+          search_threads_(search_threads),
+          transposition_table_(transposition_table_size > 0
+                                   ? std::make_shared<SurakartaAlphazeroTranspositionTable>(transposition_table_size)
+                                   : nullptr),
+          time_control_(time_control),
+          time_left_(time_control.game_time),
+          ponder_simulations_(ponder_simulations){};
 
+    ~SurakartaAgentAlphazero() override { StopPondering(); }
+
+    /// @brief
+    /// With pondering enabled, the search goes on in the background after the move is returned,
+    /// from the position it leads to, until the next call. The subtree of the opponent's actual
+    /// reply is then kept, as when reusing the tree without pondering.
     virtual SurakartaMove CalculateMove() override;
 
+    /// @brief The simulations run by the last CalculateMove(), not counting those inherited from the previous search.
+    int LastSimulationCount() const { return last_simulation_count_; }
+
+    /// @brief The transposition table shared by the searches of this agent, nullptr if disabled.
+    const SurakartaAlphazeroTranspositionTable* TranspositionTable() const { return transposition_table_.get(); }
+
+    /// @brief Drop the search tree and clear the transposition table, whose values came from the model's old
+    /// weights. The next CalculateMove() searches from scratch.
+    void ResetSearch();
+
     /// @brief Event that is triggered when all the simulations are finished.
     /// This is used to train the neural network.
     SurakartaEvent<SurakartaAlphazeroMCTS&> OnSimulationsFinished;
@@ -33,6 +64,22 @@ class SurakartaAgentAlphazero : public SurakartaAgentBase {
     int simulation_per_move_;
     float cpuct_;
     float temperature_;
+    int search_threads_;  // Worker threads sharing one search tree, see SurakartaAlphazeroMCTS::Simulate
+    std::shared_ptr<SurakartaAlphazeroTranspositionTable> transposition_table_;  // Shared by all searches of the game, nullptr if disabled
+    std::unique_ptr<SurakartaAlphazeroMCTS> mcts_;  // Kept between moves so that the subtree of the position reached can be reused
+    const SurakartaAlphazeroTimeControl time_control_;
+    std::chrono::milliseconds time_left_;  // What is left of the game time, with a GAME_TIME time control
+    int last_simulation_count_ = 0;
+    const int ponder_simulations_;  // Root simulations at most while the opponent thinks, 0 to disable pondering
+    std::thread ponder_thread_;
+    std::atomic<bool> stop_pondering_{false};
+    std::exception_ptr ponder_exception_;
+
+    /// @brief Search the position after move on a private copy of the board, in the background.
+    void StartPondering(const SurakartaMove& move);
+
+    /// @brief Wait for pondering to stop, and search the game's board again.
+    void StopPondering();
 };
 
 class SurakartaAgentAlphazeroFactory : public SurakartaDaemon::AgentFactory {
@@ -41,11 +88,15 @@ class SurakartaAgentAlphazeroFactory : public SurakartaDaemon::AgentFactory {
         std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
         int simulation_per_move,
         float cpuct,
-        float temperature)
+        float temperature,
+        int search_threads = 1,
+        size_t transposition_table_size = 0)
         : model_(model),
           simulation_per_move_(simulation_per_move),
           cpuct_(cpuct),
-          temperature_(temperature){};
+          temperature_(temperature),
+          search_threads_(search_threads),
+          transposition_table_size_(transposition_table_size){};
 
     virtual std::unique_ptr<SurakartaAgentBase> CreateAgent(
         std::shared_ptr<SurakartaGameInfo> game_info,
@@ -54,6 +105,13 @@ class SurakartaAgentAlphazeroFactory : public SurakartaDaemon::AgentFactory {
         SurakartaDaemon& daemon,
         PieceColor my_color) override;
 
+    /// @brief Search under wall-clock limits instead of for simulation_per_move simulations.
+    void SetTimeControl(const SurakartaAlphazeroTimeControl& time_control) { time_control_ = time_control; }
+
+    /// @brief Let agents search while the opponent thinks, up to ponder_simulations root simulations.
+    /// Meant for live games: in self-play, the agents would take turns competing for the same cores.
+    void SetPonderSimulations(int ponder_simulations) { ponder_simulations_ = ponder_simulations; }
+
     void AddOnSimulationsFinishedHandler(std::function<void(SurakartaAlphazeroMCTS&)> handler) {
         on_simulations_finished_list_.push_back(handler);
     }
@@ -63,5 +121,9 @@ class SurakartaAgentAlphazeroFactory : public SurakartaDaemon::AgentFactory {
     int simulation_per_move_;
     float cpuct_;
     float temperature_;
+    int search_threads_;
+    size_t transposition_table_size_;  // Positions kept per agent, 0 to disable
+    SurakartaAlphazeroTimeControl time_control_;
+    int ponder_simulations_ = 0;
     std::vector<std::function<void(SurakartaAlphazeroMCTS&)>> on_simulations_finished_list_;
 };
@@ -1,6 +1,21 @@
 #pragma once
 #include "surakarta_agent_alphazero.h"
 #include "surakarta_alphazero_mcts.h"
+#include "surakarta_alphazero_metrics.h"
+#include "surakarta_alphazero_move_generator.h"
+#include "surakarta_alphazero_neural_network_architecture.h"
 #include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_neural_network_batched.h"
+#include "surakarta_alphazero_neural_network_cache.h"
 #include "surakarta_alphazero_neural_network_factory.h"
+#include "surakarta_alphazero_neural_network_quantized.h"
+#include "surakarta_alphazero_neural_network_snapshot.h"
+#include "surakarta_alphazero_neural_network_symmetric.h"
+#include "surakarta_alphazero_position.h"
+#include "surakarta_alphazero_position_corpus.h"
+#include "surakarta_alphazero_replay_buffer.h"
+#include "surakarta_alphazero_self_play_scheduler.h"
+#include "surakarta_alphazero_symmetry.h"
+#include "surakarta_alphazero_thread_placement.h"
+#include "surakarta_alphazero_time_control.h"
 #include "surakarta_alphazero_train_util.h"
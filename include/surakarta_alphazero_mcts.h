@@ -1,8 +1,14 @@
 #pragma once
 // This class is a cpp re-implementation of https://github.com/suragnair/alpha-zero-general/blob/master/MCTS.py
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include "surakarta.h"
+#include "surakarta_alphazero_mcts_arena.h"
+#include "surakarta_alphazero_move_generator.h"
 #include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_transposition_table.h"
 
 class SurakartaAlphazeroMCTS {
    public:
@@ -10,7 +16,8 @@ class SurakartaAlphazeroMCTS {
                            std::shared_ptr<SurakartaGameInfo> game_info,
                            PieceColor my_color,
                            std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> neural_network,
-                           float cpuct);
+                           float cpuct,
+                           std::shared_ptr<SurakartaAlphazeroTranspositionTable> transposition_table = nullptr);
     ~SurakartaAlphazeroMCTS();
 
     typedef struct {
@@ -29,6 +36,56 @@ class SurakartaAlphazeroMCTS {
 
     void Simulate();
 
+    /// @brief
+    /// Run simulation_count simulations with thread_count worker threads descending the same tree.
+    /// Every worker applies moves to its own copy of the board, and virtual loss on the edges being
+    /// searched steers concurrent workers towards different branches. With thread_count <= 1 this
+    /// is the same as calling Simulate() simulation_count times.
+    /// The model should be able to serve concurrent Predict() calls efficiently, e.g. through
+    /// SurakartaAlphazeroNeuralNetworkBatched, otherwise the workers queue up on inference.
+    void Simulate(int simulation_count, int thread_count);
+
+    /// @brief When Search() stops.
+    struct SearchLimits {
+        std::chrono::steady_clock::time_point soft_deadline;  // Stop here, unless the best move is contested
+        std::chrono::steady_clock::time_point hard_deadline;  // Stop here in any case
+        int max_simulations = 0;                              // 0 = no limit
+        bool stop_early = true;                               // Stop once the most visited move cannot be overtaken
+        const std::atomic<bool>* stop = nullptr;              // Stop as soon as it is set, e.g. by another thread
+    };
+
+    /// @brief
+    /// Run simulations on thread_count workers, as Simulate() does, until the limits say to stop.
+    /// Past the soft deadline the search only goes on while the best move is contested, i.e. the
+    /// runner-up has more than half of its visits. With stop_early, the search also ends as soon as
+    /// the runner-up could not catch up with the best move in the simulations left before the
+    /// deadline, estimated from the rate so far.
+    /// The root always gets at least one visited move, so CalculateMoveProbabilities() can be called,
+    /// unless the search is stopped through limits.stop.
+    /// @return The number of simulations run.
+    int Search(const SearchLimits& limits, int thread_count);
+
+    /// @brief
+    /// Move the root to the current position of the board, keeping the statistics of its subtree.
+    /// The position is looked up among the expanded nodes at most max_depth plies below the root,
+    /// e.g. the grandchild reached by our last move and the opponent's reply. The subtree is copied
+    /// into a fresh arena and the rest of the tree is freed.
+    /// @return
+    /// false if the position is not in the tree; the tree is left unchanged and should be rebuilt.
+    bool PromoteToCurrentPosition(int max_depth = 2);
+
+    /// @brief
+    /// Read the current position from board and game_info from now on, and walk the tree on them.
+    /// A private copy of a position lets the search run while the game's board changes, e.g. when
+    /// pondering; PromoteToCurrentPosition() then moves the root to it.
+    void SetBoard(std::shared_ptr<SurakartaBoard> board, std::shared_ptr<SurakartaGameInfo> game_info) {
+        board_ = board;
+        game_info_ = game_info;
+    }
+
+    /// @brief The number of simulations the root has received so far, including those of a promoted subtree.
+    int RootSimulationCount() const { return arena_->GetNode(root_).simulation_count; }
+
     /// @brief
     /// Get the training entries without the value. This is used to train the neural network.
     /// You need to fullfill the value of the entries before training.
@@ -41,21 +98,44 @@ class SurakartaAlphazeroMCTS {
     std::shared_ptr<SurakartaGameInfo> game_info_;
     PieceColor my_color_;
     std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> neural_network_;
-    SurakartaGetAllLegalMovesUtil possible_moves_util_;
     const float cpuct_;  // self.args.cpuct
+    std::shared_ptr<SurakartaAlphazeroTranspositionTable> transposition_table_;  // Optional, nullptr if disabled
 
-    struct Node {
-        std::vector<SurakartaMove> possible_moves_;
-        int simulation_count_;                                            // self.Ns[s]
-        float Q;                                                          // self.Qsa[(father status, father to this status action)]
-        std::vector<std::unique_ptr<Node>> childs_;                       // This vector should have the same size as possible_moves_
-        std::vector<float> neural_network_predicted_move_probabilities_;  // self.Ps[s][.]
-                                                                          // This vector should have the same size as possible_moves_
-        float neural_network_predicted_value_;                            // self.Vs[s]
+    /// @brief The position a simulation walks through. Moves are made and unmade on the way down and up.
+    struct SearchContext {
+        /// @param hashed Keep the Zobrist hash up to date, which only a transposition table needs.
+        SearchContext(const SurakartaBoard& board, const SurakartaGameInfo& game_info, PieceColor my_color, bool hashed)
+            : SearchContext(SurakartaAlphazeroMoveGenerator::State(board, game_info), my_color, hashed) {}
+        SearchContext(const SurakartaAlphazeroMoveGenerator::State& state, PieceColor my_color, bool hashed)
+            : state(state),
+              my_color(my_color),
+              hash(hashed ? SurakartaAlphazeroZobristHash::Hash(state.position) : 0) {}
+        SurakartaAlphazeroMoveGenerator::State state;
+        PieceColor my_color;  // The player to move at the current node
+        uint64_t hash;        // Zobrist hash of the current position, 0 without a transposition table
+        int depth = 0;        // Plies below the root
+        int max_depth = 0;    // Deepest ply reached, for SurakartaAlphazeroMetrics
     };
-    std::unique_ptr<Node> CreateNode();
 
-    std::unique_ptr<Node> root_;
+    typedef SurakartaAlphazeroMCTSArena::NodeIndex NodeIndex;
+    NodeIndex CreateNode(SearchContext& context);
+
+    std::unique_ptr<SurakartaAlphazeroMCTSArena> arena_;
+    std::unique_ptr<SurakartaAlphazeroMCTSArena> spare_arena_;  // Receives the promoted subtree, then swapped with arena_
+    NodeIndex root_;
+    SurakartaAlphazeroMoveGenerator::State root_state_;  // The root position, which board_ moves away from between calls
+
+    /// @return The node at current_position, and its depth below node.
+    std::pair<NodeIndex, int> FindCurrentPosition(NodeIndex node,
+                                                  SearchContext& context,
+                                                  const SurakartaAlphazeroPosition& current_position,
+                                                  int max_depth);
+
+    float SimulateAndReturnValue(NodeIndex node_index, SearchContext& context);
+
+    /// @brief Run simulations from the root on thread_count workers for as long as next() returns true.
+    /// next() is called by every worker before each of its simulations.
+    void RunWorkers(int thread_count, const std::function<bool()>& next);
 
-    float SimulateAndReturnValue(Node& node);  // def getActionProb(self, canonicalBoard, temp=1):
+    bool ShouldStopSearch(const SearchLimits& limits, std::chrono::steady_clock::time_point start, int simulations) const;
 };
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include "surakarta.h"
+
+/// @brief Storage for the nodes and edges of a SurakartaAlphazeroMCTS tree.
+/// Nodes and edges are bump-allocated from fixed-size blocks and referred to by index. The edges of
+/// a node are contiguous, and every edge field lives in its own array (structure of arrays), so
+/// selection scans priors and statistics linearly. Blocks are kept across Reset(), which frees the
+/// whole tree at once. Allocation is thread-safe; everything else follows the MCTS' own rules
+/// for concurrent access.
+class SurakartaAlphazeroMCTSArena {
+   public:
+    typedef uint32_t NodeIndex;
+    typedef uint32_t EdgeIndex;
+    static constexpr NodeIndex kNoNode = UINT32_MAX;
+
+    struct Node {
+        EdgeIndex edge_begin;
+        uint32_t edge_count;
+        std::atomic<int> simulation_count;  // self.Ns[s]
+        float predicted_value;              // self.Vs[s]
+    };
+
+    /// @brief The edges of one node. All arrays have edge_count entries.
+    struct EdgeRange {
+        SurakartaMove* moves;
+        float* priors;                      // self.Ps[s][.]
+        std::atomic<int>* visit_counts;     // self.Nsa[(s, .)]
+        std::atomic<float>* value_sums;     // self.Qsa[(s, .)] * self.Nsa[(s, .)], from the view of the player to move at s
+        std::atomic<int>* virtual_losses;   // Simulations in flight through the edge
+        std::atomic<NodeIndex>* children;   // kNoNode until the child is expanded
+        uint32_t size;
+    };
+
+    SurakartaAlphazeroMCTSArena();
+    ~SurakartaAlphazeroMCTSArena();
+
+    SurakartaAlphazeroMCTSArena(const SurakartaAlphazeroMCTSArena&) = delete;
+    SurakartaAlphazeroMCTSArena& operator=(const SurakartaAlphazeroMCTSArena&) = delete;
+
+    /// @brief Allocate a node with edge_count edges, with no children and zero statistics.
+    /// Moves and priors are left for the caller to fill in. Thread-safe.
+    NodeIndex AllocateNode(uint32_t edge_count);
+
+    Node& GetNode(NodeIndex index) {
+        return node_blocks_[index / kNodeBlockSize]->nodes[index % kNodeBlockSize];
+    }
+    const Node& GetNode(NodeIndex index) const {
+        return node_blocks_[index / kNodeBlockSize]->nodes[index % kNodeBlockSize];
+    }
+    EdgeRange GetEdges(const Node& node) const;
+
+    /// @brief Copy the subtree under node of another arena into this one.
+    /// @return The index of the copied node in this arena.
+    NodeIndex CopySubtree(const SurakartaAlphazeroMCTSArena& source, NodeIndex node);
+
+    /// @brief Free every node and edge. Blocks are kept for the next tree.
+    void Reset();
+
+    size_t NodeCount() const { return node_count_; }
+    size_t EdgeCount() const { return edge_count_; }
+
+   private:
+    static constexpr uint32_t kNodeBlockSize = 1 << 12;
+    static constexpr uint32_t kEdgeBlockSize = 1 << 14;
+    static constexpr uint32_t kMaxBlocks = 1 << 14;
+
+    struct NodeBlock {
+        Node nodes[kNodeBlockSize];
+    };
+    struct EdgeBlock {
+        SurakartaMove moves[kEdgeBlockSize];
+        float priors[kEdgeBlockSize];
+        std::atomic<int> visit_counts[kEdgeBlockSize];
+        std::atomic<float> value_sums[kEdgeBlockSize];
+        std::atomic<int> virtual_losses[kEdgeBlockSize];
+        std::atomic<NodeIndex> children[kEdgeBlockSize];
+    };
+
+    std::unique_ptr<std::unique_ptr<NodeBlock>[]> node_blocks_;  // kMaxBlocks slots, so that block addresses never move
+    std::unique_ptr<std::unique_ptr<EdgeBlock>[]> edge_blocks_;
+    std::atomic<size_t> node_count_;
+    std::atomic<size_t> edge_count_;
+    std::mutex allocation_mutex_;
+};
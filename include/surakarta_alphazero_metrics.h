@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// @brief Process-wide counters, histograms and gauges of the hot paths of self-play and training.
+/// Recording is off until Enable(): every probe then costs a relaxed atomic load. Once enabled,
+/// probes are lock-free atomic adds. Per-simulation figures are gathered per search and per
+/// worker, and move generation is timed on a sample of the calls only.
+/// Collect() returns the figures since the previous call and starts a new interval, e.g. one
+/// per training iteration.
+class SurakartaAlphazeroMetrics {
+   public:
+    enum class Counter {
+        SIMULATIONS,
+        SEARCHES,
+        NODES_ALLOCATED,
+        PREDICT_CALLS,       // Predict() calls of the search, each one position
+        BATCHES,             // Forward passes of SurakartaAlphazeroNeuralNetworkBatched
+        BATCHED_POSITIONS,   // Positions in those passes
+        BATCH_CAPACITY,      // Positions those passes could have held
+        SELF_PLAY_MICROSECONDS,
+        TRAIN_SAMPLES,       // Positions times epochs
+        TRAIN_MICROSECONDS,
+        COUNT,
+    };
+
+    enum class Histogram {
+        PREDICT_LATENCY_US,  // As the search sees it, batching and caching included
+        MODEL_LOCK_WAIT_US,  // Waiting for the mutex of the tiny-dnn network
+        SEARCH_DEPTH,        // Deepest simulation of a search
+        NODES_PER_SEARCH,
+        MOVE_GENERATION_NS,
+        COUNT,
+    };
+
+    enum class Gauge {
+        POLICY_LOSS,  // Measured after training, on a sample of the training data
+        VALUE_LOSS,
+        COUNT,
+    };
+
+    struct HistogramSummary {
+        uint64_t count;
+        double mean;
+        // Upper bounds of the power of two buckets holding these ranks
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t max;
+    };
+
+    /// @brief The figures of an interval.
+    struct Report {
+        double seconds;
+        uint64_t counters[static_cast<int>(Counter::COUNT)];
+        HistogramSummary histograms[static_cast<int>(Histogram::COUNT)];
+        double gauges[static_cast<int>(Gauge::COUNT)];
+        bool gauge_set[static_cast<int>(Gauge::COUNT)];
+
+        uint64_t Get(Counter counter) const { return counters[static_cast<int>(counter)]; }
+        const HistogramSummary& Get(Histogram histogram) const { return histograms[static_cast<int>(histogram)]; }
+
+        /// @brief Simulations per second of self-play, or of the interval when self-play was not timed.
+        double SimulationsPerSecond() const;
+        double TrainSamplesPerSecond() const;
+        /// @brief Positions per batched forward pass over the batch size, 0 without batching.
+        double BatchFillRatio() const;
+
+        /// @brief One JSON object on a single line.
+        std::string ToJson(int iteration) const;
+        /// @brief The Prometheus text exposition format.
+        std::string ToPrometheus(int iteration) const;
+    };
+
+    enum class Format {
+        JSON,        // A line per interval, appended to the file
+        PROMETHEUS,  // The last interval, replacing the file, e.g. for the textfile collector of node_exporter
+    };
+
+    static SurakartaAlphazeroMetrics& Global();
+
+    void Enable(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void Add(Counter counter, uint64_t value = 1) {
+        counters_[static_cast<int>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+    void Observe(Histogram histogram, uint64_t value);
+    void Set(Gauge gauge, double value);
+
+    /// @brief The figures since the previous call, which start from zero again.
+    Report Collect();
+
+    static void Write(const std::string& path, Format format, const Report& report, int iteration);
+
+    static const char* Name(Counter counter);
+    static const char* Name(Histogram histogram);
+    static const char* Name(Gauge gauge);
+    static const char* FormatName(Format format);
+    static bool ParseFormat(const std::string& name, Format& format);
+
+    /// @brief Add the microseconds it lives to a counter, or observe them in a histogram.
+    /// Does nothing if the metrics were disabled when it was created.
+    class ScopedTimer {
+       public:
+        explicit ScopedTimer(Counter counter) : ScopedTimer(static_cast<int>(counter), -1) {}
+        explicit ScopedTimer(Histogram histogram) : ScopedTimer(-1, static_cast<int>(histogram)) {}
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+       private:
+        ScopedTimer(int counter, int histogram);
+
+        const bool enabled_;
+        const int counter_;
+        const int histogram_;
+        const std::chrono::steady_clock::time_point start_;
+    };
+
+   private:
+    static constexpr int kBucketCount = 64;  // Bucket b holds values below 2^b, from 2^(b-1) on; the last one the rest
+
+    struct HistogramData {
+        std::atomic<uint64_t> buckets[kBucketCount];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    SurakartaAlphazeroMetrics();
+
+    std::atomic<bool> enabled_;
+    std::atomic<uint64_t> counters_[static_cast<int>(Counter::COUNT)];
+    HistogramData histograms_[static_cast<int>(Histogram::COUNT)];
+    std::atomic<uint64_t> gauges_[static_cast<int>(Gauge::COUNT)];  // Bits of a double; kUnset until set
+    std::atomic<int64_t> interval_start_;                            // steady_clock ticks
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "surakarta_alphazero_position.h"
+
+/// @brief Legal moves and make/unmake on bitboards, for the hot path of SurakartaAlphazeroMCTS.
+/// It plays by the rules of surakarta-core without touching a SurakartaBoard: a piece steps to an
+/// empty neighbour, or captures by running along a loop circuit through at least one corner arc.
+/// The circuits are unrolled once into ray tables, so a capture is a scan over a table, and making a
+/// move is a few bit operations on a SurakartaAlphazeroPosition.
+/// CheckAgainstCore() cross-checks it on positions of a real game; ctest runs it over a random-play corpus.
+class SurakartaAlphazeroMoveGenerator {
+   public:
+    static constexpr int kCellCount = BOARD_SIZE * BOARD_SIZE;
+
+    /// @brief The state of a game as far as the search needs it.
+    struct State {
+        SurakartaAlphazeroPosition position;
+        uint32_t max_no_capture_round = MAX_NO_CAPTURE_ROUND;
+        bool is_end = false;
+        PieceColor winner = PieceColor::NONE;
+
+        State() = default;
+        State(const SurakartaBoard& board, const SurakartaGameInfo& game_info)
+            : position(board, game_info),
+              max_no_capture_round(game_info.max_no_capture_round_),
+              is_end(game_info.IsEnd()),
+              winner(game_info.Winner()) {}
+    };
+
+    /// @brief The legal moves of one side: the cells each of its pieces can go to.
+    /// Count() sizes the storage for Write(), so moves can be written straight into their final place.
+    struct MoveList {
+        PieceColor color = PieceColor::NONE;
+        int piece_count = 0;
+        uint8_t from[kCellCount];
+        uint64_t targets[kCellCount];  // Bitboards as in SurakartaAlphazeroPosition
+
+        int Count() const;
+
+        /// @brief Write the Count() moves ordered by from, then to, both in cell order (x, then y),
+        /// as SurakartaGetAllLegalMovesUtil lists them.
+        void Write(SurakartaMove* moves) const;
+    };
+
+    static void GenerateMoves(const SurakartaAlphazeroPosition& position, PieceColor color, MoveList& moves);
+
+    /// @brief Apply a legal move: move the piece, update the round counters and the side to move,
+    /// and tell whether the game is over, as SurakartaTemporarilyApplyMoveWithGameInfoGuardUtil does.
+    static void Make(State& state, const SurakartaMove& move);
+
+    /// @brief Make a move for the lifetime of the guard. Unmaking restores a copy of the state.
+    class ApplyMoveGuard {
+       public:
+        ApplyMoveGuard(State& state, const SurakartaMove& move) : state_(state), saved_(state) { Make(state, move); }
+        ~ApplyMoveGuard() { state_ = saved_; }
+
+        ApplyMoveGuard(const ApplyMoveGuard&) = delete;
+        ApplyMoveGuard& operator=(const ApplyMoveGuard&) = delete;
+
+        /// @brief The state before the move.
+        const State& Before() const { return saved_; }
+
+       private:
+        State& state_;
+        const State saved_;
+    };
+
+    /// @brief Compare with surakarta-core on a position: the legal moves of the side to move, and the
+    /// position, end and winner after each of them.
+    /// @param difference Receives a description of the first difference found.
+    /// @return true if both agree.
+    static bool CheckAgainstCore(const SurakartaBoard& board, const SurakartaGameInfo& game_info, std::string& difference);
+};
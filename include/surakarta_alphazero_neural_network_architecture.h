@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "surakarta_alphazero_neural_network_base.h"
+
+/// @brief The shape of a network created by SurakartaAlphazeroNeuralNetworkFactory.
+/// It is stored next to the model (see MetadataPath()), so that loading rebuilds the same graph
+/// and encodes inputs and targets the way the model was trained on.
+struct SurakartaAlphazeroNeuralNetworkArchitecture {
+    enum class Trunk {
+        DENSE,     // width-wide fully connected tanh layers over the flat encoding, see EncodeInput()
+        RESIDUAL,  // A 3x3 convolution to width channels, then depth residual blocks over the board planes
+    };
+
+    enum class PolicyHead {
+        DENSE,       // One output per from/to pair, see MoveToIndex()
+        FACTORIZED,  // One output per from cell and one per to cell; a move scores their product
+    };
+
+    enum class PolicyOutput {
+        SIGMOID,  // Each output squashed on its own and trained with MSE, as models always were
+        SOFTMAX,  // Logits trained with softmax cross-entropy (over the from and to cells separately with a
+                  // factorized head); predicted priors are normalized over the legal moves
+    };
+
+    /// @brief Planes of the residual trunk's input: my pieces, the opponent's pieces, the progress
+    /// towards the no-capture draw, and a plane of ones that marks the board inside the padding.
+    static constexpr int kPlaneCount = 4;
+    static constexpr int kFactorizedPolicySize = 2 * BOARD_SIZE * BOARD_SIZE;
+
+    Trunk trunk;
+    int width;  // Units per dense layer or channels per convolution
+    int depth;  // Dense layers or residual blocks
+    PolicyHead policy_head;
+    PolicyOutput policy_output = PolicyOutput::SIGMOID;
+
+    /// @brief The architecture of models created before architectures were configurable, and of
+    /// models without metadata.
+    static SurakartaAlphazeroNeuralNetworkArchitecture Default() {
+        return {Trunk::DENSE, SurakartaAlphazeroNeuralNetworkBase::kEncodedInputSize + SurakartaAlphazeroNeuralNetworkBase::kPolicySize + 1,
+                5, PolicyHead::DENSE, PolicyOutput::SIGMOID};
+    }
+
+    int InputSize() const {
+        return trunk == Trunk::DENSE ? SurakartaAlphazeroNeuralNetworkBase::kEncodedInputSize
+                                     : kPlaneCount * BOARD_SIZE * BOARD_SIZE;
+    }
+
+    int PolicySize() const {
+        return policy_head == PolicyHead::DENSE ? SurakartaAlphazeroNeuralNetworkBase::kPolicySize : kFactorizedPolicySize;
+    }
+
+    /// @brief Whether a network of this shape can be built, and its layers told apart when it is read back.
+    bool IsValid() const {
+        return width > 1 && depth > 0 && (trunk == Trunk::RESIDUAL || width != PolicySize());
+    }
+
+    /// @brief Encode an input the way the trunk expects it.
+    /// @param features Receives InputSize() values.
+    void EncodeInput(const SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput& input, float* features) const;
+
+    /// @brief Encode a training target for the policy head.
+    /// A factorized target holds the probability of moving from, then to, each cell.
+    /// @param policy Receives PolicySize() values.
+    void EncodePolicyTarget(const SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput& output, float* policy) const;
+
+    /// @brief The priors of moves, given all PolicySize() outputs of the policy head.
+    std::vector<float> MovePriors(const float* policy, const std::vector<SurakartaMove>& moves) const;
+
+    /// @brief The priors of moves, given the outputs of a dense policy head for those moves only.
+    std::vector<float> DenseMovePriors(std::vector<float> move_outputs) const;
+
+    /// @brief Replace values by their softmax.
+    static void Softmax(float* values, size_t count);
+
+    /// @return e.g. "residual 64x6 factorized softmax"; the output is only named when it is a softmax.
+    std::string ToString() const;
+
+    static std::string MetadataPath(const std::string& model_path) { return model_path + ".arch"; }
+
+    /// @throw std::runtime_error if the metadata cannot be written.
+    void Save(const std::string& model_path) const;
+
+    /// @return Default() if the model has no metadata.
+    /// @throw std::runtime_error if the metadata is malformed.
+    static SurakartaAlphazeroNeuralNetworkArchitecture Load(const std::string& model_path);
+};
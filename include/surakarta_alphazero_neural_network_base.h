@@ -1,5 +1,7 @@
 #pragma once
+#include <algorithm>
 #include "surakarta.h"
+#include "surakarta_alphazero_position.h"
 
 class SurakartaAlphazeroNeuralNetworkBase {
    public:
@@ -11,18 +13,67 @@ class SurakartaAlphazeroNeuralNetworkBase {
     } MoveWithProbability;
 
     typedef struct {
-        std::unique_ptr<std::vector<MoveWithProbability>> move_probabilities;
+        std::unique_ptr<std::vector<MoveWithProbability>> move_probabilities;  // From Predict(): one entry per input legal move, in the same order
         float current_status_value;
     } NeuralNetworkOutput;
 
     typedef struct {
-        std::unique_ptr<SurakartaBoard> board;
-        SurakartaGameInfo game_info;
+        SurakartaAlphazeroPosition position;
         PieceColor my_color;
+        std::vector<SurakartaMove> legal_moves;  // The moves Predict() returns priors for. Not used for training
     } NeuralNetworkInput;
 
+    /// @brief The number of from/to pairs the policy head scores.
+    static constexpr int kPolicySize = BOARD_SIZE * BOARD_SIZE * BOARD_SIZE * BOARD_SIZE;
+
+    /// @brief The index of a move in the policy head.
+    static int MoveToIndex(const SurakartaMove& move) {
+        return ((move.from.x * BOARD_SIZE + move.from.y) * BOARD_SIZE + move.to.x) * BOARD_SIZE + move.to.y;
+    }
+
+    /// @brief The number of features in an encoded input, see EncodeInput().
+    static constexpr int kEncodedInputSize = BOARD_SIZE * BOARD_SIZE + 2;
+
+    /// @brief Encode an input into the features the network sees: every cell from the view of
+    /// my_color (1 for my piece, -1 for the opponent's, 0 if empty), then the round number and
+    /// the round of the last capture.
+    /// @param features Receives kEncodedInputSize values.
+    static void EncodeInput(const NeuralNetworkInput& input, float* features) {
+        const auto mine = input.position.Pieces(input.my_color);
+        const auto theirs = input.position.Pieces(ReverseColor(input.my_color));
+        // Branch-free, so that the compiler can vectorize it
+        for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; i++) {
+            features[i] = static_cast<float>((mine >> i) & 1) - static_cast<float>((theirs >> i) & 1);
+        }
+        features[kEncodedInputSize - 2] = input.position.num_round;
+        features[kEncodedInputSize - 1] = input.position.last_captured_round;
+    }
+
+    /// @brief Encode a training target policy over the whole policy head: every move in
+    /// move_probabilities is written to its MoveToIndex() slot, every other slot is 0.
+    /// @param policy Receives kPolicySize values.
+    static void EncodePolicyTarget(const NeuralNetworkOutput& output, float* policy) {
+        std::fill(policy, policy + kPolicySize, 0.0f);
+        for (const auto& move_with_probability : *output.move_probabilities) {
+            policy[MoveToIndex(move_with_probability.move)] = move_with_probability.probability;
+        }
+    }
+
     virtual NeuralNetworkOutput Predict(NeuralNetworkInput input) = 0;
 
+    /// @brief Evaluate several positions at once.
+    /// The default implementation calls Predict() once per input; models that can run a
+    /// batched forward pass should override it.
+    /// @return The outputs, in the same order as the inputs.
+    virtual std::vector<NeuralNetworkOutput> PredictBatch(std::vector<NeuralNetworkInput> inputs) {
+        std::vector<NeuralNetworkOutput> outputs;
+        outputs.reserve(inputs.size());
+        for (auto& input : inputs) {
+            outputs.push_back(Predict(std::move(input)));
+        }
+        return outputs;
+    }
+
     typedef struct {
         std::unique_ptr<NeuralNetworkInput> input;
         std::unique_ptr<NeuralNetworkOutput> output;
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_thread_placement.h"
+
+/// @brief An inference service that gathers Predict() calls from many threads into batches.
+/// Callers block until their result is ready. A background thread takes up to max_batch_size
+/// pending requests, runs a single PredictBatch() on the underlying model, and hands every
+/// caller its own output. A batch that is not full is flushed once its oldest request has
+/// waited for flush_timeout.
+/// With a thread placement, every NUMA node has its own queue, served by a thread pinned to the
+/// node: threads pinned to a node are batched together and evaluated on it. Other threads go to
+/// the queue of the first node.
+class SurakartaAlphazeroNeuralNetworkBatched : public SurakartaAlphazeroNeuralNetworkBase {
+   public:
+    SurakartaAlphazeroNeuralNetworkBatched(std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+                                           size_t max_batch_size,
+                                           std::chrono::microseconds flush_timeout,
+                                           std::shared_ptr<const SurakartaAlphazeroThreadPlacement> placement = nullptr);
+    ~SurakartaAlphazeroNeuralNetworkBatched();
+
+    SurakartaAlphazeroNeuralNetworkBatched(const SurakartaAlphazeroNeuralNetworkBatched&) = delete;
+    SurakartaAlphazeroNeuralNetworkBatched& operator=(const SurakartaAlphazeroNeuralNetworkBatched&) = delete;
+
+    virtual NeuralNetworkOutput Predict(NeuralNetworkInput input) override;
+    virtual std::vector<NeuralNetworkOutput> PredictBatch(std::vector<NeuralNetworkInput> inputs) override;
+    virtual void Train(std::unique_ptr<std::vector<TrainEntry>> train_data) override;
+    virtual void SaveModel(const std::string& model_path) override;
+
+   private:
+    struct Request {
+        NeuralNetworkInput input;
+        std::promise<NeuralNetworkOutput> promise;
+        std::chrono::steady_clock::time_point enqueue_time;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<Request> pending;
+        bool stopping = false;
+        std::thread worker;
+    };
+
+    std::future<NeuralNetworkOutput> Enqueue(NeuralNetworkInput input);
+    void ServeLoop(Queue& queue);
+
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model_;
+    const size_t max_batch_size_;
+    const std::chrono::microseconds flush_timeout_;
+    std::unique_ptr<Queue[]> queues_;  // One per node of the placement
+    int queue_count_;
+};
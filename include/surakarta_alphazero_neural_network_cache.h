@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "surakarta_alphazero_neural_network_base.h"
+
+/// @brief A thread-safe LRU cache of network outputs in front of another model.
+/// Entries are indexed by a hash of the encoded input (see EncodeInput()) and spread over
+/// independently locked shards. Each entry keeps what the input encodes, so that inputs whose
+/// hashes collide are told apart instead of sharing an output. Priors are kept by MoveToIndex(), so a
+/// hit returns them in the order of the caller's legal moves, whatever order filled the entry.
+/// Train() and Invalidate() bump a version number, which makes every
+/// cached output stale at once, e.g. after the wrapped model has been retrained or reloaded.
+class SurakartaAlphazeroNeuralNetworkCache : public SurakartaAlphazeroNeuralNetworkBase {
+   public:
+    /// @param capacity The maximum number of cached outputs over all shards.
+    SurakartaAlphazeroNeuralNetworkCache(std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model, size_t capacity);
+
+    virtual NeuralNetworkOutput Predict(NeuralNetworkInput input) override;
+    virtual std::vector<NeuralNetworkOutput> PredictBatch(std::vector<NeuralNetworkInput> inputs) override;
+    virtual void Train(std::unique_ptr<std::vector<TrainEntry>> train_data) override;
+    virtual void SaveModel(const std::string& model_path) override;
+
+    /// @brief Drop every cached output. Call this when the wrapped model changes behind the cache's back.
+    void Invalidate() { version_++; }
+
+    size_t HitCount() const { return hit_count_; }
+    size_t MissCount() const { return miss_count_; }
+    void ResetCounters() {
+        hit_count_ = 0;
+        miss_count_ = 0;
+    }
+
+   private:
+    static constexpr size_t kShardCount = 16;
+
+    /// @brief What EncodeInput() encodes: the pieces from the view of the player to move and the round counters.
+    struct InputKey {
+        uint64_t mine;
+        uint64_t theirs;
+        uint32_t num_round;
+        uint32_t last_captured_round;
+
+        bool operator==(const InputKey& other) const {
+            return mine == other.mine && theirs == other.theirs &&
+                   num_round == other.num_round && last_captured_round == other.last_captured_round;
+        }
+        bool operator!=(const InputKey& other) const { return !(*this == other); }
+    };
+
+    struct CachedPrior {
+        int move_index;  // See MoveToIndex()
+        float probability;
+    };
+    struct CachedOutput {
+        uint64_t hash;
+        InputKey key;
+        uint64_t version;
+        std::vector<CachedPrior> priors;
+        float current_status_value;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::list<CachedOutput> entries;  // Most recently used first
+        std::unordered_map<uint64_t, std::list<CachedOutput>::iterator> index;
+    };
+
+    static InputKey KeyOf(const NeuralNetworkInput& input);
+    static uint64_t Hash(const InputKey& key);
+    Shard& ShardOf(uint64_t hash) { return shards_[hash % kShardCount]; }
+    /// @return false on a miss, and if the entry has no prior for one of legal_moves.
+    bool Lookup(const InputKey& key, uint64_t hash, const std::vector<SurakartaMove>& legal_moves, NeuralNetworkOutput& output);
+    void Store(const InputKey& key, uint64_t hash, uint64_t version, const NeuralNetworkOutput& output);
+
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model_;
+    const size_t shard_capacity_;
+    Shard shards_[kShardCount];
+    std::atomic<uint64_t> version_;
+    std::atomic<size_t> hit_count_;
+    std::atomic<size_t> miss_count_;
+};
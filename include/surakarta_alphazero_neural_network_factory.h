@@ -1,13 +1,74 @@
+#include "surakarta_alphazero_neural_network_architecture.h"
 #include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_neural_network_quantized.h"
 
 class SurakartaAlphazeroNeuralNetworkFactory : public SurakartaAlphazeroNeuralNetworkBase::ModelFactory {
    public:
-    SurakartaAlphazeroNeuralNetworkFactory(size_t train_batch_size, size_t epochs)
-        : train_batch_size_(train_batch_size), epochs_(epochs) {}
+    /// @brief How the created models run Predict(). Training always runs on tiny-dnn, and so does
+    /// prediction with a residual trunk, whichever backend is chosen. PredictBatch() runs one tiny-dnn
+    /// forward pass over the whole batch then, so residual models still benefit from batched inference.
+    enum class Backend {
+        TINY_DNN,  // tiny-dnn's own forward pass, one batch at a time
+        SCALAR,    // A weight snapshot with portable kernels, see SurakartaAlphazeroNeuralNetworkSnapshot
+        SIMD,      // A weight snapshot with the widest kernels the CPU supports
+    };
+
+    /// @brief How Train() updates the weights. Training runs Adam, whose moments and step count persist
+    /// from one Train() to the next and are saved next to the model (see OptimizerStatePath()).
+    /// The loss follows the policy output of the model, see SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput;
+    /// the value head is always trained with MSE.
+    struct TrainingOptions {
+        enum class Schedule {
+            CONSTANT,  // learning_rate throughout
+            STEP,      // learning_rate * decay ^ (step / schedule_steps)
+            COSINE,    // From learning_rate down to learning_rate * decay over schedule_steps, then flat
+        };
+
+        float learning_rate = 0.001f;
+        /// @brief Weight decay per unit of learning rate, applied to weights (not biases) after each step.
+        float l2 = 0.0f;
+        Schedule schedule = Schedule::CONSTANT;
+        long long schedule_steps = 10000;  // Counted in optimizer steps, i.e. training batches
+        float decay = 0.1f;
+        /// @brief Workers of a training step. With more than one, each batch is split between replicas of
+        /// the network, whose gradients are reduced into a single update; the update is the same as with one.
+        int threads = 1;
+
+        /// @brief The learning rate of an optimizer step.
+        float LearningRate(long long step) const;
+    };
+
+    /// @param architecture The shape of created models. Loaded models keep the shape stored with them,
+    /// see SurakartaAlphazeroNeuralNetworkArchitecture::Load().
+    SurakartaAlphazeroNeuralNetworkFactory(size_t train_batch_size,
+                                           size_t epochs,
+                                           Backend backend = Backend::SIMD,
+                                           const SurakartaAlphazeroNeuralNetworkArchitecture& architecture = SurakartaAlphazeroNeuralNetworkArchitecture::Default())
+        : train_batch_size_(train_batch_size), epochs_(epochs), backend_(backend), architecture_(architecture) {}
+    /// @throw std::invalid_argument if the architecture is not valid.
     virtual std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> CreateModel(const std::string& model_path) override;
     virtual std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> LoadModel(const std::string& model_path) override;
 
+    void UseTrainingOptions(const TrainingOptions& training_options) { training_options_ = training_options; }
+
+    static std::string OptimizerStatePath(const std::string& model_path) { return model_path + ".adam"; }
+
+    /// @brief Write an inference-only copy of a trained model with compressed weights,
+    /// see SurakartaAlphazeroNeuralNetworkQuantized.
+    /// @throw std::runtime_error if the model is not a dense network with a dense policy head.
+    static void ExportQuantized(const std::string& model_path,
+                                const std::string& quantized_model_path,
+                                SurakartaAlphazeroNeuralNetworkQuantized::Precision precision);
+
+    /// @return "tiny-dnn", "scalar" or "simd".
+    static const char* BackendName(Backend backend);
+    /// @return false if name is not a backend name.
+    static bool ParseBackend(const std::string& name, Backend& backend);
+
    private:
     const size_t train_batch_size_;
     const size_t epochs_;
+    const Backend backend_;
+    const SurakartaAlphazeroNeuralNetworkArchitecture architecture_;
+    TrainingOptions training_options_;
 };
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_neural_network_snapshot.h"
+
+/// @brief An inference-only model with compressed weights, for agents that only play.
+/// Weights are stored per output row either as INT8 with one scale per row, or as FP16; biases
+/// and activations stay FP32. A quarter (INT8) or half (FP16) of the weight bytes means more
+/// models per machine, and more of each forward pass served from the cache.
+/// Create the file with SurakartaAlphazeroNeuralNetworkFactory::ExportQuantized().
+class SurakartaAlphazeroNeuralNetworkQuantized : public SurakartaAlphazeroNeuralNetworkBase {
+   public:
+    enum class Precision {
+        INT8,
+        FP16,
+    };
+
+    /// @brief Differences between the outputs of two models on the same positions.
+    struct AccuracyReport {
+        size_t positions;
+        double policy_max_error;  // Of the prior of any legal move
+        double policy_mean_error;
+        double value_max_error;
+        double value_mean_error;
+        double top_move_agreement;  // Share of positions where both models rank the same move first
+    };
+
+    /// @brief Load a quantized model.
+    /// @throw std::runtime_error if the file cannot be read or is not a quantized model.
+    explicit SurakartaAlphazeroNeuralNetworkQuantized(const std::string& model_path);
+
+    /// @brief Quantize the layers of a network and write them to model_path.
+    static void Export(const std::string& model_path,
+                       Precision precision,
+                       const std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer>& trunk,
+                       const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& policy_head,
+                       const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& value_head);
+
+    /// @brief Compare candidate against reference on inputs.
+    static AccuracyReport CheckAccuracy(SurakartaAlphazeroNeuralNetworkBase& reference,
+                                        SurakartaAlphazeroNeuralNetworkBase& candidate,
+                                        const std::vector<NeuralNetworkInput>& inputs);
+
+    virtual NeuralNetworkOutput Predict(NeuralNetworkInput input) override;
+
+    /// @throw std::logic_error A quantized model cannot be trained.
+    virtual void Train(std::unique_ptr<std::vector<TrainEntry>> train_data) override;
+
+    /// @brief Write the quantized model, as Export() does.
+    virtual void SaveModel(const std::string& model_path) override;
+
+    Precision GetPrecision() const { return precision_; }
+
+    /// @brief The bytes taken by the weights, scales and biases.
+    size_t WeightBytes() const;
+
+   private:
+    struct QuantizedLayer {
+        int input_size;
+        int output_size;
+        int stride;  // input_size rounded up to whole SIMD registers, rows are zero padded
+        SurakartaAlphazeroNeuralNetworkSnapshot::Activation activation;
+        std::vector<int8_t> int8_weights;     // INT8: weights[o * stride + i] * scales[o] is the weight
+        std::vector<float> scales;            // INT8 only
+        std::vector<uint16_t> fp16_weights;  // FP16: IEEE half precision bits
+        std::vector<float> biases;
+    };
+
+    SurakartaAlphazeroNeuralNetworkQuantized(Precision precision,
+                                             const std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer>& trunk,
+                                             const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& policy_head,
+                                             const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& value_head);
+
+    /// @brief Check the layer shapes and pick the kernels.
+    /// @throw std::runtime_error if the layers do not form a supported network.
+    void Prepare(const std::string& model_path);
+    QuantizedLayer Quantize(const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& layer) const;
+    float Evaluate(const QuantizedLayer& layer, const float* input, int output) const;
+
+    Precision precision_;
+    std::vector<QuantizedLayer> trunk_;
+    QuantizedLayer policy_head_;
+    QuantizedLayer value_head_;
+    int max_stride_;
+    bool use_avx2_;
+};
+
+/// @brief Loads quantized models. Quantized models cannot be created from scratch, only exported
+/// from trained ones.
+class SurakartaAlphazeroNeuralNetworkQuantizedFactory : public SurakartaAlphazeroNeuralNetworkBase::ModelFactory {
+   public:
+    /// @throw std::logic_error Always.
+    virtual std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> CreateModel(const std::string& model_path) override;
+    virtual std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> LoadModel(const std::string& model_path) override;
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/// @brief An immutable copy of the weights of a network, with its own forward pass.
+/// The forward pass only reads the snapshot, so any number of threads can evaluate positions with
+/// the same snapshot at once, without locks and without copies of their own. A trainer publishes
+/// new weights by creating a new snapshot and swapping it in; evaluations that already hold the
+/// old one finish with it.
+/// Weight rows are stored aligned and zero padded to whole SIMD registers, and the dot products
+/// run on the widest instruction set the CPU supports (see Kernel).
+class SurakartaAlphazeroNeuralNetworkSnapshot {
+   public:
+    enum class Activation {
+        TANH,
+        SIGMOID,
+        IDENTITY,  // Logits, e.g. of a softmax policy head
+    };
+
+    /// @brief The instruction set of the dot products, from the most to the least portable.
+    enum class Kernel {
+        SCALAR,
+        AVX2,    // AVX2 and FMA
+        AVX512,  // AVX-512F
+    };
+
+    struct DenseLayer {
+        int input_size;
+        int output_size;
+        std::vector<float> weights;  // weights[o * input_size + i], one contiguous row per output
+        std::vector<float> biases;
+        Activation activation;
+    };
+
+    /// @param trunk Layers applied one after another to the features.
+    /// @param policy_head, value_head Layers applied to the output of the trunk.
+    /// @param kernel Lowered to BestKernel() if the CPU does not support it.
+    SurakartaAlphazeroNeuralNetworkSnapshot(uint64_t version,
+                                            const std::vector<DenseLayer>& trunk,
+                                            const DenseLayer& policy_head,
+                                            const DenseLayer& value_head,
+                                            Kernel kernel = BestKernel());
+
+    /// @brief Increases by one with every published set of weights.
+    uint64_t Version() const { return version_; }
+
+    Kernel GetKernel() const { return kernel_; }
+
+    /// @brief The widest kernel the CPU running this process supports.
+    static Kernel BestKernel();
+    static const char* KernelName(Kernel kernel);
+
+    /// @brief Evaluate a position.
+    /// Only the policy outputs that are asked for are computed.
+    /// @param features The encoded input, see SurakartaAlphazeroNeuralNetworkBase::EncodeInput().
+    /// @param policy_indexes The policy outputs wanted, see SurakartaAlphazeroNeuralNetworkBase::MoveToIndex().
+    /// @param policy Receives policy_count values, in the order of policy_indexes.
+    void Forward(const float* features,
+                 const int* policy_indexes,
+                 size_t policy_count,
+                 float* policy,
+                 float* value) const;
+
+    /// @brief Forward() for count positions at once. The trunk reads every weight row once per
+    /// group of positions instead of once per position.
+    /// @param features count encoded inputs, one after another.
+    /// @param policy_indexes, policies count vectors each; policies[i] is resized to policy_indexes[i].
+    /// @param values Receives count values.
+    void ForwardBatch(size_t count,
+                      const float* features,
+                      const std::vector<int>* policy_indexes,
+                      std::vector<float>* policies,
+                      float* values) const;
+
+   private:
+    static constexpr size_t kAlignment = 64;                        // One cache line, one AVX-512 register
+    static constexpr int kPadding = kAlignment / sizeof(float);  // Row lengths are multiples of this
+
+    template <typename T>
+    struct AlignedAllocator {
+        typedef T value_type;
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U>&) {}
+        T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kAlignment))); }
+        void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(kAlignment)); }
+        bool operator==(const AlignedAllocator&) const { return true; }
+        bool operator!=(const AlignedAllocator&) const { return false; }
+    };
+    typedef std::vector<float, AlignedAllocator<float>> AlignedVector;
+
+    struct PackedLayer {
+        int input_size;
+        int output_size;
+        int stride;             // input_size rounded up to kPadding
+        AlignedVector weights;  // weights[o * stride + i], zero beyond input_size
+        std::vector<float> biases;
+        Activation activation;
+
+        PackedLayer(const DenseLayer& layer);
+    };
+
+    static int Pad(int size) { return (size + kPadding - 1) / kPadding * kPadding; }
+
+    /// @brief Run the trunk on count inputs with the given stride; returns the buffer holding the result.
+    AlignedVector* RunTrunk(size_t count, AlignedVector& buffer_0, AlignedVector& buffer_1) const;
+
+    const uint64_t version_;
+    const Kernel kernel_;
+    std::vector<PackedLayer> trunk_;
+    PackedLayer policy_head_;
+    PackedLayer value_head_;
+    int max_stride_;
+};
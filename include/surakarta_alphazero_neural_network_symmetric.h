@@ -0,0 +1,38 @@
+#pragma once
+#include "surakarta_alphazero_neural_network_base.h"
+
+/// @brief Uses the symmetries of the board (see SurakartaAlphazeroSymmetry) in front of another model.
+/// For inference, a position can be evaluated in a random symmetry, which keeps the search from
+/// inheriting one orientation's bias, or in all of them, averaging the outputs.
+/// For training, every position can be added in all of its symmetries, which gives up to 8 times
+/// the data from the same self-play games.
+class SurakartaAlphazeroNeuralNetworkSymmetric : public SurakartaAlphazeroNeuralNetworkBase {
+   public:
+    enum class Inference {
+        NONE,     // Evaluate the position as it is
+        RANDOM,   // Evaluate one symmetry, picked at random per call
+        AVERAGE,  // Evaluate every symmetry in one batch and average the outputs
+    };
+
+    SurakartaAlphazeroNeuralNetworkSymmetric(std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+                                             Inference inference,
+                                             bool augment_training);
+
+    virtual NeuralNetworkOutput Predict(NeuralNetworkInput input) override;
+    virtual std::vector<NeuralNetworkOutput> PredictBatch(std::vector<NeuralNetworkInput> inputs) override;
+    virtual void Train(std::unique_ptr<std::vector<TrainEntry>> train_data) override;
+    virtual void SaveModel(const std::string& model_path) override;
+
+    /// @return Every entry of train_data in every symmetry, the original first.
+    static std::unique_ptr<std::vector<TrainEntry>> Augment(const std::vector<TrainEntry>& train_data);
+
+   private:
+    static NeuralNetworkInput TransformInput(int symmetry, const NeuralNetworkInput& input);
+    static int RandomSymmetry();
+    /// @brief Put the moves of input back into the output of its transformed copy.
+    static void RestoreMoves(const NeuralNetworkInput& input, NeuralNetworkOutput& output);
+
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model_;
+    const Inference inference_;
+    const bool augment_training_;
+};
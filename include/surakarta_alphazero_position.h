@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include "surakarta.h"
+
+static_assert(BOARD_SIZE * BOARD_SIZE <= 64, "A board must fit in a 64 bit bitboard");
+
+/// @brief A position in a few bytes: one bitboard per color, the side to move and the round counters.
+/// Unlike SurakartaBoard it owns no pieces, so it is cheap to copy, compare, hash and store.
+struct SurakartaAlphazeroPosition {
+    uint64_t black;  // Bit x * BOARD_SIZE + y is set if a black piece is on (x, y)
+    uint64_t white;
+    uint32_t num_round;
+    uint32_t last_captured_round;
+    PieceColor current_player;
+
+    SurakartaAlphazeroPosition()
+        : black(0), white(0), num_round(0), last_captured_round(0), current_player(PieceColor::NONE) {}
+
+    SurakartaAlphazeroPosition(const SurakartaBoard& board, const SurakartaGameInfo& game_info)
+        : black(0),
+          white(0),
+          num_round(game_info.num_round_),
+          last_captured_round(game_info.last_captured_round_),
+          current_player(game_info.current_player_) {
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            for (int y = 0; y < BOARD_SIZE; y++) {
+                const auto color = board[x][y]->GetColor();
+                if (color == PieceColor::BLACK) {
+                    black |= Bit(x, y);
+                } else if (color == PieceColor::WHITE) {
+                    white |= Bit(x, y);
+                }
+            }
+        }
+    }
+
+    static uint64_t Bit(int x, int y) { return uint64_t(1) << (x * BOARD_SIZE + y); }
+
+    /// @return The bitboard of color, 0 for NONE.
+    uint64_t Pieces(PieceColor color) const {
+        return color == PieceColor::BLACK   ? black
+               : color == PieceColor::WHITE ? white
+                                            : 0;
+    }
+
+    PieceColor ColorAt(int x, int y) const {
+        return (black & Bit(x, y))   ? PieceColor::BLACK
+               : (white & Bit(x, y)) ? PieceColor::WHITE
+                                     : PieceColor::NONE;
+    }
+
+    bool operator==(const SurakartaAlphazeroPosition& other) const {
+        return black == other.black && white == other.white &&
+               num_round == other.num_round && last_captured_round == other.last_captured_round &&
+               current_player == other.current_player;
+    }
+    bool operator!=(const SurakartaAlphazeroPosition& other) const { return !(*this == other); }
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "surakarta_alphazero_neural_network_base.h"
+
+/// @brief Positions reached by random play from the initial position, for the benchmark, the tools
+/// and the tests to run on. Choices are taken straight from the output of std::mt19937, which the
+/// standard fixes, unlike the distributions that differ between standard libraries, so a seed gives
+/// the same positions everywhere and numbers of different versions are comparable.
+class SurakartaAlphazeroPositionCorpus {
+   public:
+    struct Position {
+        std::shared_ptr<SurakartaBoard> board;
+        std::shared_ptr<SurakartaGameInfo> game_info;
+    };
+
+    /// @return count positions of unfinished games, each after up to max_plies random moves.
+    static std::vector<Position> Generate(int count, unsigned int seed, int max_plies = 60);
+
+    /// @brief The network input of the player to move in position.
+    static SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput MakeInput(const Position& position);
+};
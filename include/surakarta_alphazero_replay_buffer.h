@@ -0,0 +1,90 @@
+#pragma once
+#include <mutex>
+#include <random>
+#include "surakarta_alphazero_neural_network_base.h"
+
+/// @brief A self-play position as stored in the replay buffer. Fixed size and free of pointers,
+/// so records can be written to and read from a file as they are.
+struct SurakartaAlphazeroReplayRecord {
+    /// @brief The most policy entries kept per position; more entries than this are cut,
+    /// dropping the least visited moves.
+    static constexpr int kMaxPolicySize = 128;
+
+    uint64_t black_plane;  // SurakartaAlphazeroPosition::black
+    uint64_t white_plane;
+    uint32_t num_round;
+    uint32_t last_captured_round;
+    float outcome;         // The value target, from the view of side_to_move
+    uint8_t side_to_move;  // 0: black, 1: white
+    uint8_t reserved;
+    uint16_t policy_size;
+    uint16_t policy_moves[kMaxPolicySize];          // SurakartaAlphazeroNeuralNetworkBase::MoveToIndex()
+    uint16_t policy_probabilities[kMaxPolicySize];  // Visit share scaled to 0..65535
+
+    static SurakartaAlphazeroReplayRecord Encode(const SurakartaAlphazeroNeuralNetworkBase::TrainEntry& entry);
+    SurakartaAlphazeroNeuralNetworkBase::TrainEntry Decode() const;
+};
+
+/// @brief A bounded store of self-play positions in a memory-mapped file, so that training can
+/// draw from a sliding window of many more positions than one iteration plays, and the window
+/// survives restarts.
+/// The file is a header followed by a ring of capacity records. Once the ring is full, every
+/// append replaces the oldest record. All methods are thread-safe.
+class SurakartaAlphazeroReplayBuffer {
+   public:
+    enum class Sampling {
+        UNIFORM,           // Every stored position is equally likely
+        RECENCY_WEIGHTED,  // The chance of a position grows linearly from the oldest to the newest
+    };
+
+    /// @brief Open the buffer at path, or create it if the file does not exist.
+    /// An existing buffer keeps the capacity it was created with.
+    /// @throw std::runtime_error if the file cannot be mapped or is not a replay buffer.
+    SurakartaAlphazeroReplayBuffer(const std::string& path, size_t capacity);
+    ~SurakartaAlphazeroReplayBuffer();
+
+    SurakartaAlphazeroReplayBuffer(const SurakartaAlphazeroReplayBuffer&) = delete;
+    SurakartaAlphazeroReplayBuffer& operator=(const SurakartaAlphazeroReplayBuffer&) = delete;
+
+    /// @brief Store positions whose outputs carry the visit distribution and the game result.
+    void Append(const std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>& entries);
+
+    /// @brief Draw count positions, with replacement.
+    /// @return An empty vector if the buffer is empty.
+    std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> Sample(
+        size_t count, Sampling sampling, std::mt19937& random_engine) const;
+
+    /// @brief Write the mapped pages back to the file.
+    void Flush();
+
+    /// @brief The number of positions currently stored.
+    size_t Size() const;
+    size_t Capacity() const { return capacity_; }
+
+    /// @brief The number of positions ever appended, including those overwritten since.
+    uint64_t TotalAppended() const;
+
+   private:
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t capacity;
+        uint64_t total_appended;
+    };
+
+    SurakartaAlphazeroReplayRecord* Records() const;
+    void Map(const std::string& path, size_t file_size, bool create);
+    void Unmap();
+
+    size_t capacity_;
+    FileHeader* header_;  // Start of the mapping
+    size_t mapped_size_;
+#ifdef _WIN32
+    void* file_handle_;
+    void* mapping_handle_;
+#else
+    int file_descriptor_;
+#endif
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "surakarta.h"
+#include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_thread_placement.h"
+
+/// @brief Plays self-play games on a persistent pool of worker threads.
+/// Every worker plays one game at a time, a move at a time, and starts a new game as soon as its
+/// game ends. PlayGames() returns as soon as enough games have finished: the games still running
+/// are paused between two moves, and finish during the next call instead of holding up this one.
+/// Call OnWeightsChanged() after training, so that they do not go on with trees searched by the old weights.
+/// A worker searches its move synchronously, waiting for the network at every leaf. With batched
+/// inference, use more threads than cores so that batches fill up, see SurakartaAlphazeroNeuralNetworkBatched.
+/// With a thread placement, worker i is pinned with SurakartaAlphazeroThreadPlacement::PinWorker(i).
+class SurakartaAlphazeroSelfPlayScheduler {
+   public:
+    struct GameResult {
+        std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> train_entries;  // Values set to the result
+        SurakartaGameInfo game_info;
+        size_t transposition_hits = 0;  // Of the transposition tables of both players, if enabled
+        size_t transposition_misses = 0;
+    };
+
+    SurakartaAlphazeroSelfPlayScheduler(std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+                                        int simulation_per_move,
+                                        float cpuct,
+                                        float temperature,
+                                        int thread_count,
+                                        std::shared_ptr<const SurakartaAlphazeroThreadPlacement> placement = nullptr,
+                                        size_t transposition_table_size = 0);
+    ~SurakartaAlphazeroSelfPlayScheduler();
+
+    SurakartaAlphazeroSelfPlayScheduler(const SurakartaAlphazeroSelfPlayScheduler&) = delete;
+    SurakartaAlphazeroSelfPlayScheduler& operator=(const SurakartaAlphazeroSelfPlayScheduler&) = delete;
+
+    /// @brief Play until game_count games have finished, then pause the pool.
+    /// Games finished by workers that were still moving when the pool paused are kept for the next call.
+    /// @param on_game_finished Called on the calling thread for each game returned, in the order they finished.
+    /// @throw The first exception thrown by a worker.
+    std::vector<GameResult> PlayGames(int game_count, const std::function<void(const GameResult&)>& on_game_finished = nullptr);
+
+    /// @brief Make every paused game drop its search trees and transposition tables before its next move.
+    /// Call it between two calls of PlayGames() once the weights of the model have changed.
+    void OnWeightsChanged();
+
+    /// @brief Set the value target of every entry of a game to its result, from the view of the player to move.
+    static void SetValueTargets(std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>& train_entries,
+                                const SurakartaGameInfo& game_info);
+
+   private:
+    struct Game;
+
+    /// @brief Create a game and its agents. Called without mutex_ held.
+    std::unique_ptr<Game> StartGame();
+
+    /// @brief Block until the worker may play a move, and count it as active.
+    /// @param weights_version Set to weights_version_ as of the turn.
+    /// @return false if the pool stops.
+    bool WaitForTurn(int& weights_version);
+
+    void Work(int worker);
+
+    const std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model_;
+    const int simulation_per_move_;
+    const float cpuct_;
+    const float temperature_;
+    const std::shared_ptr<const SurakartaAlphazeroThreadPlacement> placement_;
+    const size_t transposition_table_size_;  // Positions kept per agent, 0 to disable
+
+    std::vector<std::thread> workers_;
+
+    // Each worker keeps its game to itself; the lock is only taken between two moves
+    std::mutex mutex_;  // Guards everything below
+    std::condition_variable changed_;
+    bool running_ = false;  // Between the start and the end of PlayGames()
+    bool stopping_ = false;
+    int active_workers_ = 0;  // Workers playing a move
+    int weights_version_ = 0;  // Bumped by OnWeightsChanged()
+    std::deque<GameResult> finished_;
+    std::exception_ptr exception_;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "surakarta_alphazero_position.h"
+
+/// @brief The symmetries of the board: the 4 rotations and 4 reflections of the square.
+/// The loop circuits look the same under all of them, so a transformed position plays exactly
+/// like the original one with the transformed moves.
+/// Symmetry 0 is the identity.
+class SurakartaAlphazeroSymmetry {
+   public:
+    static constexpr int kCount = 8;
+
+    /// @brief The symmetry that undoes symmetry.
+    static int Inverse(int symmetry);
+
+    static SurakartaPosition TransformCell(int symmetry, const SurakartaPosition& cell);
+    static SurakartaAlphazeroPosition TransformPosition(int symmetry, const SurakartaAlphazeroPosition& position);
+    static SurakartaMove TransformMove(int symmetry, const SurakartaMove& move);
+
+    /// @brief Transform an index of the policy head, see SurakartaAlphazeroNeuralNetworkBase::MoveToIndex().
+    static int TransformMoveIndex(int symmetry, int index);
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/// @brief Where worker threads run on a machine with several NUMA nodes.
+/// Worker i of a pool goes to node i % NodeCount(), so that every pool spreads evenly over the nodes.
+/// A pinned thread remembers its node (see CurrentNode()): SurakartaAlphazeroNeuralNetworkBatched
+/// batches its predictions with those of its node, and the snapshot backends read a copy of the
+/// weights made on its node. Memory is placed by the first thread that touches it, as Linux does by
+/// default, so copies made by a pinned thread live on its node.
+/// The topology is read from /sys/devices/system/node on Linux. Elsewhere, or when it cannot be
+/// read, the machine is a single node, and pinning does nothing off Linux.
+class SurakartaAlphazeroThreadPlacement {
+   public:
+    enum class Policy {
+        NONE,  // Let the OS place threads
+        NODE,  // Pin each worker to all the CPUs of its node
+        CORE,  // Pin each worker to a single CPU of its node
+    };
+
+    /// @param max_nodes Use at most this many nodes, 0 for all of them.
+    SurakartaAlphazeroThreadPlacement(Policy policy, int max_nodes = 0);
+
+    Policy GetPolicy() const { return policy_; }
+
+    /// @brief The nodes workers are spread over, 1 with Policy::NONE.
+    int NodeCount() const { return static_cast<int>(nodes_.size()); }
+
+    /// @brief Pin the calling thread as worker number worker of a pool.
+    /// Best effort: does nothing with Policy::NONE, and the thread keeps running where it is if the
+    /// OS refuses.
+    void PinWorker(int worker) const;
+
+    /// @brief Pin the calling thread to all the CPUs of a node, whatever the policy but NONE.
+    void PinToNode(int node) const;
+
+    /// @brief The node the calling thread was pinned to, -1 if it was not pinned.
+    static int CurrentNode();
+
+    /// @brief The CPUs of every node of the machine this process may run on.
+    static const std::vector<std::vector<int>>& Topology();
+
+    static const char* PolicyName(Policy policy);
+    static bool ParsePolicy(const std::string& name, Policy& policy);
+
+   private:
+    static bool Pin(const std::vector<int>& cpus);
+
+    const Policy policy_;
+    std::vector<std::vector<int>> nodes_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include "surakarta_alphazero_mcts.h"
+
+/// @brief Wall-clock limits on the search of SurakartaAgentAlphazero.
+/// Without one (NONE), the agent runs a fixed number of simulations per move, as in self-play.
+struct SurakartaAlphazeroTimeControl {
+    enum class Mode {
+        NONE,       // simulation_per_move simulations per move
+        MOVE_TIME,  // move_time per move
+        GAME_TIME,  // game_time for all of our moves plus increment per move, shared out by Limits()
+    };
+
+    Mode mode = Mode::NONE;
+    std::chrono::milliseconds move_time{0};
+    std::chrono::milliseconds game_time{0};
+    std::chrono::milliseconds increment{0};
+    /// @brief GAME_TIME: the time left is shared out as if this many moves were left.
+    int moves_to_go = 30;
+    /// @brief GAME_TIME: a move whose best child is still contested at the end of its share may
+    /// take up to this multiple of it, and never more than half the time left.
+    float max_extension = 2.0f;
+    /// @brief Simulations per move at most, including those inherited from the previous search, 0 = no limit.
+    int max_simulations = 0;
+    /// @brief Stop as soon as the most visited move cannot be overtaken, see SurakartaAlphazeroMCTS::Search().
+    bool stop_early = true;
+
+    static SurakartaAlphazeroTimeControl MoveTime(std::chrono::milliseconds move_time) {
+        SurakartaAlphazeroTimeControl time_control;
+        time_control.mode = Mode::MOVE_TIME;
+        time_control.move_time = move_time;
+        return time_control;
+    }
+
+    static SurakartaAlphazeroTimeControl GameTime(std::chrono::milliseconds game_time,
+                                                  std::chrono::milliseconds increment = std::chrono::milliseconds(0)) {
+        SurakartaAlphazeroTimeControl time_control;
+        time_control.mode = Mode::GAME_TIME;
+        time_control.game_time = game_time;
+        time_control.increment = increment;
+        return time_control;
+    }
+
+    /// @brief The limits of a search starting at start.
+    /// @param time_left GAME_TIME: what is left of game_time, see game_time and increment.
+    SurakartaAlphazeroMCTS::SearchLimits Limits(std::chrono::steady_clock::time_point start,
+                                                std::chrono::milliseconds time_left) const;
+};
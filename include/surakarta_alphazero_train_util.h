@@ -1,5 +1,15 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include "surakarta_alphazero_metrics.h"
 #include "surakarta_alphazero_neural_network_base.h"
+#include "surakarta_alphazero_neural_network_batched.h"
+#include "surakarta_alphazero_neural_network_cache.h"
+#include "surakarta_alphazero_neural_network_symmetric.h"
+#include "surakarta_alphazero_replay_buffer.h"
+#include "surakarta_alphazero_self_play_scheduler.h"
 
 class SurakartaAlphazeroTrainUtil {
    public:
@@ -7,29 +17,165 @@ class SurakartaAlphazeroTrainUtil {
         std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
         int simulation_per_move,
         float cpuct,
-        float temperature)
+        float temperature,
+        int inference_batch_size = 1,
+        std::chrono::microseconds inference_flush_timeout = std::chrono::microseconds(1000),
+        size_t inference_cache_size = 0,
+        SurakartaAlphazeroNeuralNetworkSymmetric::Inference symmetric_inference = SurakartaAlphazeroNeuralNetworkSymmetric::Inference::NONE,
+        bool augment_symmetries = false,
+        std::shared_ptr<const SurakartaAlphazeroThreadPlacement> thread_placement = nullptr)
         : model_(model),
+          shared_model_(CreateInferenceStack(model, inference_batch_size, inference_flush_timeout, inference_cache_size,
+                                             symmetric_inference, augment_symmetries, thread_placement)),
+          inference_cache_(std::dynamic_pointer_cast<SurakartaAlphazeroNeuralNetworkCache>(shared_model_)),
           simulation_per_move_(simulation_per_move),
           cpuct_(cpuct),
-          temperature_(temperature){};
+          temperature_(temperature),
+          thread_placement_(thread_placement),
+          replay_sample_count_(0),
+          replay_sampling_(SurakartaAlphazeroReplayBuffer::Sampling::UNIFORM),
+          games_per_iteration_(std::max<int>(std::thread::hardware_concurrency(), 1)),
+          self_play_threads_(std::max<int>(std::thread::hardware_concurrency(), 1)),
+          transposition_table_size_(0),
+          random_engine_(std::random_device()()){};
+
+    /// @brief Wrap model in the enabled inference layers, from the bottom: batching, symmetries, cache.
+    /// Self-play predicts through the returned model and training goes through it too, so that the
+    /// training data is augmented and the cache is invalidated.
+    /// @param thread_placement Batch the predictions of each NUMA node apart, nullptr to batch them all together.
+    static std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> CreateInferenceStack(
+        std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+        int inference_batch_size,
+        std::chrono::microseconds inference_flush_timeout,
+        size_t inference_cache_size,
+        SurakartaAlphazeroNeuralNetworkSymmetric::Inference symmetric_inference,
+        bool augment_symmetries,
+        std::shared_ptr<const SurakartaAlphazeroThreadPlacement> thread_placement = nullptr);
+
+    /// @brief Play the games of an iteration and train the model on them.
+    /// All games share the model, through the inference stack, see CreateInferenceStack().
+    /// The games run on a SurakartaAlphazeroSelfPlayScheduler that lives across iterations:
+    /// games unfinished at the end of an iteration resume in the next one.
+    void TrainSingleIteration(std::shared_ptr<SurakartaLogger> logger);
+
+    /// @brief Play one self-play game.
+    /// @return The positions of the game, with the game result as value target.
+    static std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> PlayGame(
+        std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+        int simulation_per_move,
+        float cpuct,
+        float temperature,
+        SurakartaGameInfo& game_info);
+
+    /// @brief Store self-play positions in a replay buffer and train on samples drawn from it,
+    /// instead of on exactly the positions of the iteration.
+    /// @param sample_count Positions per training step, 0 for as many as the iteration played.
+    void UseReplayBuffer(std::shared_ptr<SurakartaAlphazeroReplayBuffer> replay_buffer,
+                         size_t sample_count,
+                         SurakartaAlphazeroReplayBuffer::Sampling sampling) {
+        replay_buffer_ = replay_buffer;
+        replay_sample_count_ = sample_count;
+        replay_sampling_ = sampling;
+    }
+
+    /// @brief Finish games_per_iteration games per iteration, on thread_count threads each playing
+    /// one game at a time, see SurakartaAlphazeroSelfPlayScheduler.
+    /// By default, as many games and threads as hardware threads.
+    void UseSelfPlaySchedule(int games_per_iteration, int thread_count) {
+        games_per_iteration_ = games_per_iteration;
+        self_play_threads_ = thread_count;
+        self_play_scheduler_.reset();
+    }
 
-    /// @brief Do a single self-play game and train the model
-    void TrainSingleIteration(std::shared_ptr<SurakartaLogger> logger,
-                              std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase::ModelFactory> model_factory = nullptr,
-                              std::string model_path = "");  // Used for duplicate model to utilize multi-threading
+    /// @brief Give each self-play agent a transposition table of evaluations keeping size positions,
+    /// see SurakartaAlphazeroTranspositionTable. Disabled by default.
+    void UseTranspositionTable(size_t size) {
+        transposition_table_size_ = size;
+        self_play_scheduler_.reset();
+    }
 
    private:
     std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model_;
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> shared_model_;      // The top of the inference stack
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkCache> inference_cache_;  // nullptr if caching is disabled
     int simulation_per_move_;
     float cpuct_;
     float temperature_;
+    std::shared_ptr<const SurakartaAlphazeroThreadPlacement> thread_placement_;  // nullptr to let the OS place self-play threads
+    std::shared_ptr<SurakartaAlphazeroReplayBuffer> replay_buffer_;  // nullptr if training on the last iteration only
+    size_t replay_sample_count_;
+    SurakartaAlphazeroReplayBuffer::Sampling replay_sampling_;
+    int games_per_iteration_;
+    int self_play_threads_;
+    size_t transposition_table_size_;
+    std::unique_ptr<SurakartaAlphazeroSelfPlayScheduler> self_play_scheduler_;  // Created by the first iteration
+    std::mt19937 random_engine_;
 };
 
 class SurakartaAlphazeroLoadTrainSaveUtil {
    public:
     SurakartaAlphazeroLoadTrainSaveUtil(
         std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase::ModelFactory> model_factory)
-        : model_factory_(model_factory){};
+        : model_factory_(model_factory),
+          inference_batch_size_(1),
+          inference_flush_timeout_(1000),
+          inference_cache_size_(0),
+          replay_sample_count_(0),
+          replay_sampling_(SurakartaAlphazeroReplayBuffer::Sampling::UNIFORM),
+          symmetric_inference_(SurakartaAlphazeroNeuralNetworkSymmetric::Inference::NONE),
+          augment_symmetries_(false),
+          games_per_iteration_(std::max<int>(std::thread::hardware_concurrency(), 1)),
+          self_play_threads_(std::max<int>(std::thread::hardware_concurrency(), 1)),
+          transposition_table_size_(0),
+          metrics_format_(SurakartaAlphazeroMetrics::Format::JSON){};
+
+    /// @brief Batch and cache the predictions of self-play, see SurakartaAlphazeroTrainUtil::CreateInferenceStack.
+    /// By default, every prediction runs on its own and nothing is cached.
+    void UseInference(int batch_size, std::chrono::microseconds flush_timeout, size_t cache_size) {
+        inference_batch_size_ = batch_size;
+        inference_flush_timeout_ = flush_timeout;
+        inference_cache_size_ = cache_size;
+    }
+
+    /// @brief See SurakartaAlphazeroTrainUtil::UseReplayBuffer.
+    void UseReplayBuffer(std::shared_ptr<SurakartaAlphazeroReplayBuffer> replay_buffer,
+                         size_t sample_count,
+                         SurakartaAlphazeroReplayBuffer::Sampling sampling) {
+        replay_buffer_ = replay_buffer;
+        replay_sample_count_ = sample_count;
+        replay_sampling_ = sampling;
+    }
+
+    /// @brief Use the symmetries of the board in self-play and training,
+    /// see SurakartaAlphazeroNeuralNetworkSymmetric.
+    void UseSymmetries(SurakartaAlphazeroNeuralNetworkSymmetric::Inference inference, bool augment_training) {
+        symmetric_inference_ = inference;
+        augment_symmetries_ = augment_training;
+    }
+
+    /// @brief Pin self-play threads, pipelined actors and the batched inference threads to NUMA
+    /// nodes, see SurakartaAlphazeroThreadPlacement.
+    void UseThreadPlacement(std::shared_ptr<const SurakartaAlphazeroThreadPlacement> thread_placement) {
+        thread_placement_ = thread_placement;
+    }
+
+    /// @brief See SurakartaAlphazeroTrainUtil::UseSelfPlaySchedule. Not used by TrainPipelined().
+    void UseSelfPlaySchedule(int games_per_iteration, int thread_count) {
+        games_per_iteration_ = games_per_iteration;
+        self_play_threads_ = thread_count;
+    }
+
+    /// @brief See SurakartaAlphazeroTrainUtil::UseTranspositionTable. Not used by TrainPipelined().
+    void UseTranspositionTable(size_t size) { transposition_table_size_ = size; }
+
+    /// @brief Record SurakartaAlphazeroMetrics while training, log a summary of every iteration
+    /// (every step when pipelined) and write its figures to a file, see SurakartaAlphazeroMetrics::Format.
+    /// @param path The metrics file, empty to only log the summaries.
+    void UseMetrics(const std::string& path, SurakartaAlphazeroMetrics::Format format) {
+        use_metrics_ = true;
+        metrics_path_ = path;
+        metrics_format_ = format;
+    }
 
     void Train(
         const std::string& model_path,
@@ -39,6 +185,45 @@ class SurakartaAlphazeroLoadTrainSaveUtil {
         float temperature,
         std::shared_ptr<SurakartaLogger> logger = std::make_shared<SurakartaLoggerNull>());
 
+    /// @brief Like Train(), but self-play and training run at the same time.
+    /// actor_count threads keep playing games into the replay buffer. Meanwhile this thread trains
+    /// on samples of the buffer; the weights of every step are published to the actors as soon as
+    /// it finishes, and the model is saved every save_interval steps. When the replay sample count
+    /// is 0, each step trains on as many positions as were played since the previous step.
+    /// Needs a replay buffer, see UseReplayBuffer().
+    /// @param iterations Training steps.
+    /// @throw std::invalid_argument if actor_count or save_interval is below 1.
+    void TrainPipelined(
+        const std::string& model_path,
+        int iterations,
+        int actor_count,
+        int save_interval,
+        int simulation_per_move,
+        float cpuct,
+        float temperature,
+        std::shared_ptr<SurakartaLogger> logger = std::make_shared<SurakartaLoggerNull>());
+
    private:
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> LoadOrCreateModel(const std::string& model_path,
+                                                                          std::shared_ptr<SurakartaLogger> logger);
+
+    /// @brief Collect the metrics of the iteration that just finished, log them and write them to the metrics file.
+    void ReportMetrics(int iteration, std::shared_ptr<SurakartaLogger> logger);
+
     std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase::ModelFactory> model_factory_;
+    int inference_batch_size_;
+    std::chrono::microseconds inference_flush_timeout_;
+    size_t inference_cache_size_;
+    std::shared_ptr<SurakartaAlphazeroReplayBuffer> replay_buffer_;
+    size_t replay_sample_count_;
+    SurakartaAlphazeroReplayBuffer::Sampling replay_sampling_;
+    SurakartaAlphazeroNeuralNetworkSymmetric::Inference symmetric_inference_;
+    bool augment_symmetries_;
+    std::shared_ptr<const SurakartaAlphazeroThreadPlacement> thread_placement_;  // nullptr to let the OS place threads
+    int games_per_iteration_;
+    int self_play_threads_;
+    size_t transposition_table_size_;
+    bool use_metrics_ = false;
+    std::string metrics_path_;  // Empty to only log the metrics
+    SurakartaAlphazeroMetrics::Format metrics_format_;
 };
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include "surakarta.h"
+#include "surakarta_alphazero_position.h"
+
+/// @brief Zobrist hash of a position: the pieces on the board, the side to move and the number of
+/// rounds since the last capture. It can be updated incrementally while moves are applied.
+class SurakartaAlphazeroZobristHash {
+   public:
+    static uint64_t Hash(const SurakartaAlphazeroPosition& position);
+
+    /// @brief Update the hash for the changes between two positions, e.g. before and after a move.
+    static uint64_t Update(uint64_t hash, const SurakartaAlphazeroPosition& before, const SurakartaAlphazeroPosition& after);
+};
+
+/// @brief A bounded, thread-safe table of neural network evaluations keyed by Zobrist hash, so that
+/// positions reached by different move orders are evaluated once.
+/// Positions hash into buckets of two entries; when both are taken, the least recently used one is
+/// replaced.
+class SurakartaAlphazeroTranspositionTable {
+   public:
+    /// @param capacity The maximum number of positions kept.
+    explicit SurakartaAlphazeroTranspositionTable(size_t capacity);
+
+    struct Entry {
+        float value;
+        std::vector<float> priors;  // In the order of SurakartaAlphazeroMoveGenerator::MoveList::Write
+    };
+
+    /// @return false if the position is not in the table.
+    bool Lookup(uint64_t hash, Entry& entry);
+    void Store(uint64_t hash, float value, const float* priors, size_t prior_count);
+    void Clear();
+
+    size_t HitCount() const { return hit_count_; }
+    size_t MissCount() const { return miss_count_; }
+
+   private:
+    static constexpr size_t kBucketSize = 2;
+    static constexpr size_t kLockCount = 64;
+
+    struct Slot {
+        bool used = false;
+        uint64_t hash = 0;
+        uint64_t last_used = 0;
+        Entry entry;
+    };
+
+    std::mutex& LockOf(size_t bucket) { return locks_[bucket % kLockCount]; }
+
+    const size_t bucket_count_;
+    std::vector<Slot> slots_;  // bucket_count_ * kBucketSize
+    std::unique_ptr<std::mutex[]> locks_;
+    std::atomic<uint64_t> clock_;
+    std::atomic<size_t> hit_count_;
+    std::atomic<size_t> miss_count_;
+};
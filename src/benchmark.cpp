@@ -1,5 +1,405 @@
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
 #include "surakarta_alphazero.h"
 
-int main() {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+using Position = SurakartaAlphazeroPositionCorpus::Position;
+
+/// @brief The outcome of one benchmark case.
+struct BenchmarkResult {
+    std::string name;
+    std::string parameters;  // e.g. "cpuct=1;simulations=50"
+    size_t samples;          // Timed operations
+    double mean_us;
+    double p50_us;
+    double p95_us;
+    double throughput;
+    std::string throughput_unit;
+};
+
+/// @brief Collects the latency of one operation per sample.
+class LatencyRecorder {
+   public:
+    template <typename Function>
+    void Measure(Function function) {
+        const auto start = Clock::now();
+        function();
+        latencies_us_.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    /// @param work_per_sample How many units of throughput_unit a single sample did.
+    BenchmarkResult Result(const std::string& name, const std::string& parameters,
+                           double work_per_sample, const std::string& throughput_unit) {
+        BenchmarkResult result{name, parameters, latencies_us_.size(), 0, 0, 0, 0, throughput_unit};
+        if (latencies_us_.empty()) {
+            return result;
+        }
+        std::sort(latencies_us_.begin(), latencies_us_.end());
+        double total_us = 0;
+        for (const auto latency : latencies_us_) {
+            total_us += latency;
+        }
+        result.mean_us = total_us / latencies_us_.size();
+        result.p50_us = latencies_us_[latencies_us_.size() / 2];
+        result.p95_us = latencies_us_[std::min(latencies_us_.size() - 1, latencies_us_.size() * 95 / 100)];
+        result.throughput = total_us > 0 ? work_per_sample * latencies_us_.size() / (total_us / 1e6) : 0;
+        return result;
+    }
+
+   private:
+    std::vector<double> latencies_us_;
+};
+
+std::vector<int> ParseIntList(const char* text) {
+    std::vector<int> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+std::vector<float> ParseFloatList(const char* text) {
+    std::vector<float> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stof(item));
+    }
+    return values;
+}
+
+std::string FormatParameters(const std::vector<std::pair<std::string, std::string>>& parameters) {
+    std::string text;
+    for (const auto& parameter : parameters) {
+        text += (text.empty() ? "" : ";") + parameter.first + "=" + parameter.second;
+    }
+    return text;
+}
+
+std::string ToString(float value) {
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+}
+
+void WriteJson(std::ostream& out, unsigned int seed, int position_count, const std::vector<BenchmarkResult>& results) {
+    out << "{\n  \"seed\": " << seed << ",\n  \"positions\": " << position_count << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"parameters\": \"" << result.parameters
+            << "\", \"samples\": " << result.samples << ", \"mean_us\": " << result.mean_us
+            << ", \"p50_us\": " << result.p50_us << ", \"p95_us\": " << result.p95_us
+            << ", \"throughput\": " << result.throughput << ", \"throughput_unit\": \"" << result.throughput_unit << "\"}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+void WriteCsv(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "name,parameters,samples,mean_us,p50_us,p95_us,throughput,throughput_unit\n";
+    for (const auto& result : results) {
+        out << result.name << "," << result.parameters << "," << result.samples << "," << result.mean_us << ","
+            << result.p50_us << "," << result.p95_us << "," << result.throughput << "," << result.throughput_unit << "\n";
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        printf("Usage:  %s model_path [args...]\n", argv[0]);
+        printf("Notice: The model must exist, e.g. created by surakarta-alphazero-train.\n");
+        printf("        The model is trained during the benchmark but never saved.\n");
+        printf("Args:   -p|--positions <int>      Number of positions in the corpus, default = 64\n");
+        printf("        --seed <int>              Seed of the position corpus, default = 0\n");
+        printf("        -s|--simulations <list>   Comma separated simulations per move, default = 50,200\n");
+        printf("        -c|--cpuct <list>         Comma separated CPUCT values, default = 1.0\n");
+        printf("        --batch-sizes <list>      Comma separated PredictBatch sizes, default = 8,32\n");
+        printf("        --backends <list>         Comma separated inference backends for predict and predict_batch,\n");
+        printf("                                  tiny-dnn, scalar or simd; the other cases use the first, default = simd\n");
+        printf("        --move-times <list>       Comma separated milliseconds per move of the timed search, empty to skip,\n");
+        printf("                                  default = 50\n");
+        printf("        --threads <int>           Search threads, default = 1\n");
+        printf("        -g|--games <int>          Self-play games, 0 to skip, default = 1\n");
+        printf("        --format <json|csv>       Output format, default = json\n");
+        printf("        -o|--output <path>        Output file, default = stdout\n");
+        printf("Example: %s model.bin -p 16 -s 10,50 -c 0.5,1.0 -g 0 --format csv -o result.csv\n", argv[0]);
+        return 1;
+    }
+    int position_count = 64;
+    unsigned int seed = 0;
+    std::vector<int> simulation_counts = {50, 200};
+    std::vector<float> cpucts = {1.0f};
+    std::vector<int> batch_sizes = {8, 32};
+    std::vector<SurakartaAlphazeroNeuralNetworkFactory::Backend> backends = {SurakartaAlphazeroNeuralNetworkFactory::Backend::SIMD};
+    std::vector<int> move_times = {50};
+    int search_threads = 1;
+    int game_count = 1;
+    std::string format = "json";
+    std::string output_path;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--positions") == 0) {
+            position_count = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--simulations") == 0) {
+            simulation_counts = ParseIntList(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cpuct") == 0) {
+            cpucts = ParseFloatList(argv[++i]);
+        } else if (strcmp(argv[i], "--batch-sizes") == 0) {
+            batch_sizes = ParseIntList(argv[++i]);
+        } else if (strcmp(argv[i], "--backends") == 0) {
+            backends.clear();
+            std::stringstream stream(argv[++i]);
+            std::string name;
+            while (std::getline(stream, name, ',')) {
+                SurakartaAlphazeroNeuralNetworkFactory::Backend backend;
+                if (!SurakartaAlphazeroNeuralNetworkFactory::ParseBackend(name, backend)) {
+                    fprintf(stderr, "Unknown backend %s\n", name.c_str());
+                    return 1;
+                }
+                backends.push_back(backend);
+            }
+            if (backends.empty()) {
+                fprintf(stderr, "No backend given\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--move-times") == 0) {
+            move_times = ParseIntList(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            search_threads = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--games") == 0) {
+            game_count = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
+            output_path = argv[++i];
+        }
+    }
+
+    // Progress goes to stderr, so that stdout only carries the results
+    const auto log = [](const char* name) { fprintf(stderr, "Running %s\n", name); };
+    if (!std::filesystem::exists(argv[1])) {
+        fprintf(stderr, "Model %s does not exist\n", argv[1]);
+        return 1;
+    }
+    std::vector<std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase>> models;
+    for (const auto backend : backends) {
+        models.push_back(SurakartaAlphazeroNeuralNetworkFactory(32, 1, backend).LoadModel(argv[1]));
+    }
+    const auto model = models.front();
+    const auto positions = SurakartaAlphazeroPositionCorpus::Generate(position_count, seed);
+    std::vector<BenchmarkResult> results;
+
+    log("predict");
+    for (size_t b = 0; b < backends.size(); b++) {
+        LatencyRecorder recorder;
+        for (const auto& position : positions) {
+            auto input = SurakartaAlphazeroPositionCorpus::MakeInput(position);
+            recorder.Measure([&]() { models[b]->Predict(std::move(input)); });
+        }
+        results.push_back(recorder.Result("predict",
+                                          FormatParameters({{"backend", SurakartaAlphazeroNeuralNetworkFactory::BackendName(backends[b])}}),
+                                          1, "positions/s"));
+    }
+
+    log("predict_batch");
+    for (size_t b = 0; b < backends.size(); b++) {
+        for (const auto batch_size : batch_sizes) {
+            LatencyRecorder recorder;
+            for (size_t begin = 0; begin + batch_size <= positions.size(); begin += batch_size) {
+                std::vector<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput> inputs;
+                for (size_t i = begin; i < begin + batch_size; i++) {
+                    inputs.push_back(SurakartaAlphazeroPositionCorpus::MakeInput(positions[i]));
+                }
+                recorder.Measure([&]() { models[b]->PredictBatch(std::move(inputs)); });
+            }
+            results.push_back(recorder.Result("predict_batch",
+                                              FormatParameters({{"backend", SurakartaAlphazeroNeuralNetworkFactory::BackendName(backends[b])},
+                                                                {"batch_size", std::to_string(batch_size)}}),
+                                              batch_size, "positions/s"));
+        }
+    }
+
+    // Constructing a search expands its root: legal move generation, one Predict and the node allocation
+    log("create_node");
+    {
+        LatencyRecorder recorder;
+        for (const auto& position : positions) {
+            recorder.Measure([&]() {
+                SurakartaAlphazeroMCTS mcts(position.board, position.game_info, position.game_info->current_player_, model, 1.0f);
+            });
+        }
+        results.push_back(recorder.Result("create_node", "", 1, "nodes/s"));
+    }
+
+    // The search generates and makes moves on bitboards; it must play by the same rules as the core
+    log("move_generation");
+    for (const auto& position : positions) {
+        std::string difference;
+        if (!SurakartaAlphazeroMoveGenerator::CheckAgainstCore(*position.board, *position.game_info, difference)) {
+            fprintf(stderr, "The move generator disagrees with surakarta-core: %s\n", difference.c_str());
+            return 1;
+        }
+    }
+    {
+        LatencyRecorder core_recorder;
+        LatencyRecorder bitboard_recorder;
+        for (const auto& position : positions) {
+            SurakartaGetAllLegalMovesUtil legal_moves_util(position.board);
+            core_recorder.Measure([&]() { legal_moves_util.GetAllLegalMoves(position.game_info->current_player_); });
+            const SurakartaAlphazeroMoveGenerator::State state(*position.board, *position.game_info);
+            bitboard_recorder.Measure([&]() {
+                SurakartaAlphazeroMoveGenerator::MoveList move_list;
+                SurakartaAlphazeroMoveGenerator::GenerateMoves(state.position, state.position.current_player, move_list);
+                std::vector<SurakartaMove> moves(move_list.Count());
+                move_list.Write(moves.data());
+            });
+        }
+        results.push_back(core_recorder.Result("move_generation", FormatParameters({{"engine", "core"}}), 1, "positions/s"));
+        results.push_back(bitboard_recorder.Result("move_generation", FormatParameters({{"engine", "bitboard"}}), 1, "positions/s"));
+    }
+
+    // Making and unmaking every legal move of a position
+    log("make_unmake");
+    {
+        LatencyRecorder core_recorder;
+        LatencyRecorder bitboard_recorder;
+        for (const auto& position : positions) {
+            SurakartaGetAllLegalMovesUtil legal_moves_util(position.board);
+            const auto moves = legal_moves_util.GetAllLegalMoves(position.game_info->current_player_);
+            core_recorder.Measure([&]() {
+                for (const auto& move : *moves) {
+                    SurakartaTemporarilyApplyMoveWithGameInfoGuardUtil guard(position.board, position.game_info, move);
+                }
+            });
+            SurakartaAlphazeroMoveGenerator::State state(*position.board, *position.game_info);
+            bitboard_recorder.Measure([&]() {
+                for (const auto& move : *moves) {
+                    SurakartaAlphazeroMoveGenerator::ApplyMoveGuard guard(state, move);
+                }
+            });
+        }
+        results.push_back(core_recorder.Result("make_unmake", FormatParameters({{"engine", "core"}}), 1, "positions/s"));
+        results.push_back(bitboard_recorder.Result("make_unmake", FormatParameters({{"engine", "bitboard"}}), 1, "positions/s"));
+    }
+
+    log("mcts_simulate");
+    for (const auto cpuct : cpucts) {
+        for (const auto simulation_count : simulation_counts) {
+            LatencyRecorder recorder;
+            for (const auto& position : positions) {
+                SurakartaAlphazeroMCTS mcts(position.board, position.game_info, position.game_info->current_player_, model, cpuct);
+                recorder.Measure([&]() { mcts.Simulate(simulation_count, search_threads); });
+            }
+            results.push_back(recorder.Result("mcts_simulate",
+                                              FormatParameters({{"cpuct", ToString(cpuct)},
+                                                                {"simulations", std::to_string(simulation_count)},
+                                                                {"threads", std::to_string(search_threads)}}),
+                                              simulation_count, "simulations/s"));
+        }
+    }
+
+    log("calculate_move");
+    for (const auto simulation_count : simulation_counts) {
+        LatencyRecorder recorder;
+        for (const auto& position : positions) {
+            // Copies, so that a move picked by the agent cannot leak into the corpus
+            auto board = std::make_shared<SurakartaBoard>(*position.board);
+            auto game_info = std::make_shared<SurakartaGameInfo>(*position.game_info);
+            SurakartaAgentAlphazero agent(board, game_info, nullptr, game_info->current_player_, model,
+                                          simulation_count, cpucts.front(), 0.0f, search_threads);
+            recorder.Measure([&]() { agent.CalculateMove(); });
+        }
+        results.push_back(recorder.Result("calculate_move",
+                                          FormatParameters({{"simulations", std::to_string(simulation_count)},
+                                                            {"threads", std::to_string(search_threads)}}),
+                                          1, "moves/s"));
+    }
+
+    // Searches stopped by the clock, or earlier once the best move is settled
+    log("calculate_move_timed");
+    for (const auto move_time : move_times) {
+        LatencyRecorder recorder;
+        long long simulation_count = 0;
+        for (const auto& position : positions) {
+            auto board = std::make_shared<SurakartaBoard>(*position.board);
+            auto game_info = std::make_shared<SurakartaGameInfo>(*position.game_info);
+            SurakartaAgentAlphazero agent(board, game_info, nullptr, game_info->current_player_, model, 0, cpucts.front(),
+                                          0.0f, search_threads, 0,
+                                          SurakartaAlphazeroTimeControl::MoveTime(std::chrono::milliseconds(move_time)));
+            recorder.Measure([&]() { agent.CalculateMove(); });
+            simulation_count += agent.LastSimulationCount();
+        }
+        results.push_back(recorder.Result(
+            "calculate_move_timed",
+            FormatParameters({{"move_time_ms", std::to_string(move_time)},
+                              {"threads", std::to_string(search_threads)},
+                              {"mean_simulations", std::to_string(positions.empty() ? 0 : simulation_count / static_cast<long long>(positions.size()))}}),
+            1, "moves/s"));
+    }
+
+    if (game_count > 0) {
+        log("self_play");
+        LatencyRecorder recorder;
+        int move_count = 0;
+        auto agent_factory = std::make_shared<SurakartaAgentAlphazeroFactory>(
+            model, simulation_counts.front(), cpucts.front(), 1.0f, search_threads);
+        agent_factory->AddOnSimulationsFinishedHandler([&move_count](SurakartaAlphazeroMCTS&) { move_count++; });
+        for (int i = 0; i < game_count; i++) {
+            recorder.Measure([&]() {
+                auto daemon = SurakartaDaemon(BOARD_SIZE, MAX_NO_CAPTURE_ROUND, agent_factory, agent_factory);
+                daemon.Execute();
+            });
+        }
+        results.push_back(recorder.Result("self_play",
+                                          FormatParameters({{"simulations", std::to_string(simulation_counts.front())},
+                                                            {"threads", std::to_string(search_threads)},
+                                                            {"moves", std::to_string(move_count)}}),
+                                          3600, "games/h"));
+    }
+
+    log("train");
+    {
+        // Targets spread evenly over the legal moves; the value does not matter for the timing
+        auto train_data = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>>();
+        for (const auto& position : positions) {
+            auto input = SurakartaAlphazeroPositionCorpus::MakeInput(position);
+            auto output = std::make_unique<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput>();
+            output->move_probabilities = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::MoveWithProbability>>();
+            for (const auto& move : input.legal_moves) {
+                output->move_probabilities->push_back({move, 1.0f / input.legal_moves.size()});
+            }
+            output->current_status_value = 0.0f;
+            train_data->push_back({std::make_unique<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput>(std::move(input)),
+                                   std::move(output)});
+        }
+        LatencyRecorder recorder;
+        const auto sample_count = train_data->size();
+        recorder.Measure([&]() { model->Train(std::move(train_data)); });
+        results.push_back(recorder.Result("train", FormatParameters({{"samples", std::to_string(sample_count)}}),
+                                          sample_count, "samples/s"));
+    }
+
+    std::ofstream file;
+    if (!output_path.empty()) {
+        file.open(output_path);
+    }
+    std::ostream& out = output_path.empty() ? std::cout : file;
+    if (format == "csv") {
+        WriteCsv(out, results);
+    } else {
+        WriteJson(out, seed, position_count, results);
+    }
     return 0;
 }
@@ -0,0 +1,68 @@
+#include <string.h>
+#include <filesystem>
+#include "surakarta_alphazero.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage:  %s model_path quantized_model_path [args...]\n", argv[0]);
+        printf("Notice: Writes an inference-only copy of a trained model with compressed weights, and\n");
+        printf("        compares its outputs with those of the original model.\n");
+        printf("Args:   --precision <int8|fp16>  Weight format, default = int8\n");
+        printf("        -p|--positions <int>     Number of positions to compare on, default = 256\n");
+        printf("        --seed <int>             Seed of the positions, default = 0\n");
+        printf("        --tolerance <float>      Fail if a policy or value output differs by more, default = no limit\n");
+        printf("Example: %s model.bin model.int8 --precision int8 -p 1000 --tolerance 0.05\n", argv[0]);
+        return 1;
+    }
+    auto precision = SurakartaAlphazeroNeuralNetworkQuantized::Precision::INT8;
+    int position_count = 256;
+    unsigned int seed = 0;
+    double tolerance = -1;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--precision") == 0) {
+            const char* name = argv[++i];
+            if (strcmp(name, "int8") == 0) {
+                precision = SurakartaAlphazeroNeuralNetworkQuantized::Precision::INT8;
+            } else if (strcmp(name, "fp16") == 0) {
+                precision = SurakartaAlphazeroNeuralNetworkQuantized::Precision::FP16;
+            } else {
+                printf("Unknown precision %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--positions") == 0) {
+            position_count = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--tolerance") == 0) {
+            tolerance = std::stod(argv[++i]);
+            if (tolerance < 0) {
+                printf("Invalid tolerance %s, it must not be negative\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+
+    auto logger = std::make_shared<SurakartaLoggerStdout>();
+    const char* precision_name = precision == SurakartaAlphazeroNeuralNetworkQuantized::Precision::INT8 ? "int8" : "fp16";
+    logger->Log("Quantizing %s to %s (%s)", argv[1], argv[2], precision_name);
+    SurakartaAlphazeroNeuralNetworkFactory::ExportQuantized(argv[1], argv[2], precision);
+    const auto reference = SurakartaAlphazeroNeuralNetworkFactory(1, 1).LoadModel(argv[1]);
+    const auto quantized = SurakartaAlphazeroNeuralNetworkQuantizedFactory().LoadModel(argv[2]);
+    logger->Log(" - Model file:            %llu bytes", static_cast<unsigned long long>(std::filesystem::file_size(argv[1])));
+    logger->Log(" - Quantized model file:  %llu bytes", static_cast<unsigned long long>(std::filesystem::file_size(argv[2])));
+
+    logger->Log("Comparing outputs on %d positions (seed %u)", position_count, seed);
+    std::vector<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput> inputs;
+    for (const auto& position : SurakartaAlphazeroPositionCorpus::Generate(position_count, seed)) {
+        inputs.push_back(SurakartaAlphazeroPositionCorpus::MakeInput(position));
+    }
+    const auto report = SurakartaAlphazeroNeuralNetworkQuantized::CheckAccuracy(*reference, *quantized, inputs);
+    logger->Log(" - Policy error:          max %f, mean %f", report.policy_max_error, report.policy_mean_error);
+    logger->Log(" - Value error:           max %f, mean %f", report.value_max_error, report.value_mean_error);
+    logger->Log(" - Top move agreement:    %.2f%%", report.top_move_agreement * 100);
+    if (tolerance >= 0 && (report.policy_max_error > tolerance || report.value_max_error > tolerance)) {
+        logger->Log("Outputs differ by more than the tolerance %f", tolerance);
+        return 1;
+    }
+    return 0;
+}
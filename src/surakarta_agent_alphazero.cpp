@@ -1,32 +1,66 @@
 #include "surakarta_agent_alphazero.h"
-#include "global_random_generator.h"
+#include <random>
+#include <utility>
 #include "surakarta_alphazero_mcts.h"
 
 // returns a random float between 0 and 1
 static float random_float() {
-    auto& random_engine = GlobalRandomGenerator::getInstance();
+    // Per thread: games run in parallel during training, and the global generator is not thread-safe
+    thread_local std::mt19937 random_engine(std::random_device{}());
     const auto random_int = random_engine();
     return static_cast<float>(random_int - random_engine.min()) /
            static_cast<float>(random_engine.max() - random_engine.min());
 }
 
 SurakartaMove SurakartaAgentAlphazero::CalculateMove() {
-    auto mcts = SurakartaAlphazeroMCTS(
-        board_,
-        game_info_,
-        my_color_,
-        model_,
-        cpuct_);
-    for (int i = 0; i < simulation_per_move_; i++) {
-        mcts.Simulate();
-    }
-    OnSimulationsFinished.Invoke(mcts);
-    const auto possibilities = mcts.CalculateMoveProbabilities(temperature_);
+    const auto start = std::chrono::steady_clock::now();
+    StopPondering();
+    if (ponder_exception_) {
+        std::rethrow_exception(std::exchange(ponder_exception_, nullptr));
+    }
+    // Reuse the subtree of the current position if our last move and the opponent's reply were searched
+    if (mcts_ == nullptr || !mcts_->PromoteToCurrentPosition()) {
+        mcts_ = std::make_unique<SurakartaAlphazeroMCTS>(
+            board_,
+            game_info_,
+            my_color_,
+            model_,
+            cpuct_,
+            transposition_table_);
+    }
+    last_simulation_count_ = 0;
+    if (time_control_.mode == SurakartaAlphazeroTimeControl::Mode::NONE) {
+        // Simulations inherited from the previous search count towards this move's budget
+        const auto simulation_count = simulation_per_move_ - mcts_->RootSimulationCount();
+        if (simulation_count > 0) {
+            mcts_->Simulate(simulation_count, search_threads_);
+            last_simulation_count_ = simulation_count;
+        }
+    } else {
+        auto limits = time_control_.Limits(start, time_left_);
+        const bool capped = limits.max_simulations > 0;
+        if (capped) {
+            // As above, inherited simulations count towards the cap
+            limits.max_simulations -= mcts_->RootSimulationCount();
+        }
+        if (!capped || limits.max_simulations > 0) {
+            last_simulation_count_ = mcts_->Search(limits, search_threads_);
+        }
+    }
+    OnSimulationsFinished.Invoke(*mcts_);
+    if (time_control_.mode == SurakartaAlphazeroTimeControl::Mode::GAME_TIME) {
+        time_left_ += time_control_.increment -
+                      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    }
+    const auto possibilities = mcts_->CalculateMoveProbabilities(temperature_);
     float cursor = 0;
     const auto random_value = random_float();
     for (const auto possibility : *possibilities) {
         cursor += possibility.probability;
         if (cursor >= random_value) {
+            if (ponder_simulations_ > 0) {
+                StartPondering(possibility.move);
+            }
             return possibility.move;
         }
     }
@@ -34,6 +68,63 @@ SurakartaMove SurakartaAgentAlphazero::CalculateMove() {
     return SurakartaMove(SurakartaPosition(0, 0), SurakartaPosition(0, 0), my_color_);
 }
 
+void SurakartaAgentAlphazero::StartPondering(const SurakartaMove& move) {
+    // The daemon applies the move to the game's board once we return, and the opponent's reply
+    // after that; the search works on a copy that stays at the position in between.
+    auto board = std::make_shared<SurakartaBoard>(*board_);
+    auto game_info = std::make_shared<SurakartaGameInfo>(*game_info_);
+    std::shared_ptr<SurakartaBoard> ponder_board;
+    std::shared_ptr<SurakartaGameInfo> ponder_game_info;
+    {
+        SurakartaTemporarilyApplyMoveWithGameInfoGuardUtil guard(board, game_info, move);
+        ponder_board = std::make_shared<SurakartaBoard>(*board);
+        ponder_game_info = std::make_shared<SurakartaGameInfo>(*game_info);
+    }
+    if (ponder_game_info->IsEnd()) {
+        return;
+    }
+    mcts_->SetBoard(ponder_board, ponder_game_info);
+    if (!mcts_->PromoteToCurrentPosition(1)) {
+        mcts_->SetBoard(board_, game_info_);
+        return;
+    }
+    SurakartaAlphazeroMCTS::SearchLimits limits;
+    limits.soft_deadline = std::chrono::steady_clock::time_point::max();
+    limits.hard_deadline = std::chrono::steady_clock::time_point::max();
+    limits.max_simulations = ponder_simulations_ - mcts_->RootSimulationCount();
+    limits.stop_early = false;
+    limits.stop = &stop_pondering_;
+    if (limits.max_simulations <= 0) {
+        return;
+    }
+    stop_pondering_ = false;
+    ponder_thread_ = std::thread([this, limits]() {
+        try {
+            mcts_->Search(limits, search_threads_);
+        } catch (...) {
+            ponder_exception_ = std::current_exception();
+        }
+    });
+}
+
+void SurakartaAgentAlphazero::StopPondering() {
+    if (ponder_thread_.joinable()) {
+        stop_pondering_ = true;
+        ponder_thread_.join();
+    }
+    if (mcts_ != nullptr) {
+        mcts_->SetBoard(board_, game_info_);
+    }
+}
+
+void SurakartaAgentAlphazero::ResetSearch() {
+    StopPondering();
+    mcts_.reset();
+    if (transposition_table_ != nullptr) {
+        transposition_table_->Clear();
+    }
+}
+
 std::unique_ptr<SurakartaAgentBase> SurakartaAgentAlphazeroFactory::CreateAgent(
     std::shared_ptr<SurakartaGameInfo> game_info,
     std::shared_ptr<SurakartaBoard> board,
@@ -41,7 +132,8 @@ std::unique_ptr<SurakartaAgentBase> SurakartaAgentAlphazeroFactory::CreateAgent(
     SurakartaDaemon& daemon,
     PieceColor my_color) {
     auto agent = std::make_unique<SurakartaAgentAlphazero>(
-        board, game_info, rule_manager, my_color, model_, simulation_per_move_, cpuct_, temperature_);
+        board, game_info, rule_manager, my_color, model_, simulation_per_move_, cpuct_, temperature_, search_threads_,
+        transposition_table_size_, time_control_, ponder_simulations_);
     for (int i = 0; i < on_simulations_finished_list_.size(); i++) {
         agent->OnSimulationsFinished.AddListener(on_simulations_finished_list_[i]);
     }
@@ -3,31 +3,58 @@
 #include "surakarta_alphazero_mcts.h"
 #include <assert.h>
 #include <algorithm>
+#include <chrono>
+#include <exception>
 #include <numeric>
+#include <random>
+#include <thread>
+#include "surakarta_alphazero_metrics.h"
+
+static void AtomicAdd(std::atomic<float>& target, float value) {
+    float expected = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed)) {
+    }
+}
 
 SurakartaAlphazeroMCTS::SurakartaAlphazeroMCTS(
     std::shared_ptr<SurakartaBoard> board,
     std::shared_ptr<SurakartaGameInfo> game_info,
     PieceColor my_color,
     std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> neural_network,
-    float cpuct)
+    float cpuct,
+    std::shared_ptr<SurakartaAlphazeroTranspositionTable> transposition_table)
     : board_(board),
       game_info_(game_info),
       my_color_(my_color),
       neural_network_(neural_network),
-      possible_moves_util_(board),
-      cpuct_(cpuct) {
-    root_ = CreateNode();
+      cpuct_(cpuct),
+      transposition_table_(transposition_table),
+      arena_(std::make_unique<SurakartaAlphazeroMCTSArena>()),
+      spare_arena_(std::make_unique<SurakartaAlphazeroMCTSArena>()) {
+    auto context = SearchContext(*board_, *game_info_, my_color_, transposition_table_ != nullptr);
+    root_ = CreateNode(context);
+    root_state_ = context.state;
 }
 
 SurakartaAlphazeroMCTS::~SurakartaAlphazeroMCTS() {}
 
-std::unique_ptr<SurakartaAlphazeroMCTS::Node> SurakartaAlphazeroMCTS::CreateNode() {
-    auto node = std::make_unique<Node>();
-    node->possible_moves_ = *possible_moves_util_.GetAllLegalMoves(my_color_);
-    node->simulation_count_ = 0;
-    node->Q = 0;
-    node->childs_.resize(node->possible_moves_.size());
+SurakartaAlphazeroMCTS::NodeIndex SurakartaAlphazeroMCTS::CreateNode(SearchContext& context) {
+    auto& metrics = SurakartaAlphazeroMetrics::Global();
+    SurakartaAlphazeroMoveGenerator::MoveList possible_moves;
+    // Reading the clock would cost about as much as generating the moves, so only a sample is timed
+    thread_local unsigned int generation_count = 0;
+    if (metrics.Enabled() && generation_count++ % 64 == 0) {
+        const auto start = std::chrono::steady_clock::now();
+        SurakartaAlphazeroMoveGenerator::GenerateMoves(context.state.position, context.my_color, possible_moves);
+        metrics.Observe(SurakartaAlphazeroMetrics::Histogram::MOVE_GENERATION_NS,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    } else {
+        SurakartaAlphazeroMoveGenerator::GenerateMoves(context.state.position, context.my_color, possible_moves);
+    }
+    const auto node_index = arena_->AllocateNode(possible_moves.Count());
+    auto& node = arena_->GetNode(node_index);
+    const auto edges = arena_->GetEdges(node);
+    possible_moves.Write(edges.moves);
 
     /*
     if s not in self.Ps:
@@ -50,44 +77,50 @@ std::unique_ptr<SurakartaAlphazeroMCTS::Node> SurakartaAlphazeroMCTS::CreateNode
         self.Ns[s] = 0
         return -v
     */
+    // A position reached through another move order has already been evaluated
+    SurakartaAlphazeroTranspositionTable::Entry transposition;
+    if (transposition_table_ != nullptr &&
+        transposition_table_->Lookup(context.hash, transposition) &&
+        transposition.priors.size() == edges.size) {
+        std::copy(transposition.priors.begin(), transposition.priors.end(), edges.priors);
+        node.predicted_value = transposition.value;
+        return node_index;
+    }
+
     SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput input;
-    input.board = std::make_unique<SurakartaBoard>(*board_);
-    input.game_info = *game_info_;
-    input.my_color = my_color_;
-    const auto neural_network_output = neural_network_->Predict(std::move(input));
-    node->neural_network_predicted_move_probabilities_.resize(node->possible_moves_.size());
-    if (node->possible_moves_.size() > 0) {
-        for (int i = 0; i < node->possible_moves_.size(); i++) {
-            node->neural_network_predicted_move_probabilities_[i] = 0;
-        }
-        for (auto& output_entry : *neural_network_output.move_probabilities) {
-            int move_index = -1;
-            for (int i = 0; i < node->possible_moves_.size(); i++) {
-                if (node->possible_moves_[i].from == output_entry.move.from && node->possible_moves_[i].to == output_entry.move.to) {
-                    move_index = i;
-                    break;
-                }
-            }
-            if (move_index >= 0) {  // is valid move
-                node->neural_network_predicted_move_probabilities_[move_index] = output_entry.probability;
-            }
+    input.position = context.state.position;
+    input.my_color = context.my_color;
+    input.legal_moves.assign(edges.moves, edges.moves + edges.size);
+    const auto neural_network_output = [&]() {
+        SurakartaAlphazeroMetrics::ScopedTimer timer(SurakartaAlphazeroMetrics::Histogram::PREDICT_LATENCY_US);
+        return neural_network_->Predict(std::move(input));
+    }();
+    if (metrics.Enabled()) {
+        metrics.Add(SurakartaAlphazeroMetrics::Counter::PREDICT_CALLS);
+    }
+    if (edges.size > 0) {
+        // The network only scores the legal moves, in the order they were given
+        assert(neural_network_output.move_probabilities->size() == edges.size);
+        for (int i = 0; i < edges.size; i++) {
+            edges.priors[i] = (*neural_network_output.move_probabilities)[i].probability;
         }
-        const auto sum = std::accumulate(
-            node->neural_network_predicted_move_probabilities_.begin(), node->neural_network_predicted_move_probabilities_.end(), 0.0f);
+        const auto sum = std::accumulate(edges.priors, edges.priors + edges.size, 0.0f);
         if (sum > 0) {
-            for (auto& probability : node->neural_network_predicted_move_probabilities_) {
-                probability /= sum;
+            for (int i = 0; i < edges.size; i++) {
+                edges.priors[i] /= sum;
             }
         } else {
             fprintf(stderr, "All valid moves were masked, doing a workaround.\n");
-            for (auto& probability : node->neural_network_predicted_move_probabilities_) {
-                probability = 1.0f / node->possible_moves_.size();
+            for (int i = 0; i < edges.size; i++) {
+                edges.priors[i] = 1.0f / edges.size;
             }
         }
     }
-    node->Q = neural_network_output.current_status_value;
-    node->neural_network_predicted_value_ = neural_network_output.current_status_value;
-    return node;
+    node.predicted_value = neural_network_output.current_status_value;
+    if (transposition_table_ != nullptr) {
+        transposition_table_->Store(context.hash, node.predicted_value, edges.priors, edges.size);
+    }
+    return node_index;
 }
 
 // def getActionProb(self, canonicalBoard, temp=1):
@@ -110,42 +143,43 @@ SurakartaAlphazeroMCTS::CalculateMoveProbabilities(float temperature) const {
     return probs
     */
 
-    if (root_->possible_moves_.size() == 0) {
+    const auto edges = arena_->GetEdges(arena_->GetNode(root_));
+    if (edges.size == 0) {
         return std::make_unique<std::vector<MoveWithProbability>>();
     }
     int simulation_count_max = 0;
-    for (int i = 0; i < root_->possible_moves_.size(); i++) {
-        if (root_->childs_[i] != nullptr && root_->childs_[i]->simulation_count_ > simulation_count_max) {
-            simulation_count_max = root_->childs_[i]->simulation_count_;
+    for (int i = 0; i < edges.size; i++) {
+        if (edges.visit_counts[i] > simulation_count_max) {
+            simulation_count_max = edges.visit_counts[i];
         }
     }
     if (simulation_count_max == 0)
         throw std::runtime_error("SurakartaAlphazeroMCTS::Simulate() should be called more than twice, but it's not");
     if (temperature == 0) {
         auto best_move_indexes = std::vector<int>();
-        for (int i = 0; i < root_->possible_moves_.size(); i++) {
-            if (root_->childs_[i] != nullptr && root_->childs_[i]->simulation_count_ == simulation_count_max) {
+        for (int i = 0; i < edges.size; i++) {
+            if (edges.visit_counts[i] == simulation_count_max) {
                 best_move_indexes.push_back(i);
             }
         }
-        const auto best_move_index = best_move_indexes[GlobalRandomGenerator::getInstance()() % best_move_indexes.size()];
-        auto ret = std::make_unique<std::vector<MoveWithProbability>>(root_->possible_moves_.size());
-        for (int i = 0; i < root_->possible_moves_.size(); i++) {
+        thread_local std::mt19937 random_engine(std::random_device{}());
+        const auto best_move_index = best_move_indexes[random_engine() % best_move_indexes.size()];
+        auto ret = std::make_unique<std::vector<MoveWithProbability>>(edges.size);
+        for (int i = 0; i < edges.size; i++) {
             if (i == best_move_index) {
-                (*ret)[i] = {root_->possible_moves_[i], 1.0f};
+                (*ret)[i] = {edges.moves[i], 1.0f};
             } else {
-                (*ret)[i] = {root_->possible_moves_[i], 0.0f};
+                (*ret)[i] = {edges.moves[i], 0.0f};
             }
         }
         return ret;
     } else {
         auto counts_with_temperature = std::vector<float>();
         auto counts_with_temperature_moves = std::vector<SurakartaMove>();
-        for (int i = 0; i < root_->possible_moves_.size(); i++) {
-            if (root_->childs_[i] != nullptr) {
-                assert(root_->childs_[i]->simulation_count_ > 0);
-                counts_with_temperature.push_back(std::pow(root_->childs_[i]->simulation_count_, 1.0f / temperature));
-                counts_with_temperature_moves.push_back(root_->possible_moves_[i]);
+        for (int i = 0; i < edges.size; i++) {
+            if (edges.visit_counts[i] > 0) {
+                counts_with_temperature.push_back(std::pow(static_cast<float>(edges.visit_counts[i]), 1.0f / temperature));
+                counts_with_temperature_moves.push_back(edges.moves[i]);
             }
         }
         const auto counts_sum = std::accumulate(counts_with_temperature.begin(), counts_with_temperature.end(), 0.0f);
@@ -158,29 +192,207 @@ SurakartaAlphazeroMCTS::CalculateMoveProbabilities(float temperature) const {
 }
 
 void SurakartaAlphazeroMCTS::Simulate() {
-    SimulateAndReturnValue(*root_);
+    auto context = SearchContext(*board_, *game_info_, my_color_, transposition_table_ != nullptr);
+    SimulateAndReturnValue(root_, context);
+}
+
+void SurakartaAlphazeroMCTS::Simulate(int simulation_count, int thread_count) {
+    std::atomic<int> remaining_simulations(simulation_count);
+    RunWorkers(thread_count, [&remaining_simulations]() { return remaining_simulations.fetch_sub(1) > 0; });
+}
+
+int SurakartaAlphazeroMCTS::Search(const SearchLimits& limits, int thread_count) {
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<int> simulations(0);
+    std::atomic<bool> stopped(false);
+    RunWorkers(thread_count, [&]() {
+        if (stopped.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (ShouldStopSearch(limits, start, simulations.load(std::memory_order_relaxed))) {
+            stopped.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        if (simulations.fetch_add(1, std::memory_order_relaxed) >= limits.max_simulations && limits.max_simulations > 0) {
+            simulations.fetch_sub(1, std::memory_order_relaxed);
+            stopped.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    });
+    return simulations.load();
+}
+
+bool SurakartaAlphazeroMCTS::ShouldStopSearch(const SearchLimits& limits,
+                                              std::chrono::steady_clock::time_point start,
+                                              int simulations) const {
+    if (limits.stop != nullptr && limits.stop->load(std::memory_order_relaxed)) {
+        return true;
+    }
+    const auto edges = arena_->GetEdges(arena_->GetNode(root_));
+    int best = 0;
+    int second = 0;
+    for (int i = 0; i < edges.size; i++) {
+        const int visit_count = edges.visit_counts[i].load(std::memory_order_relaxed);
+        if (visit_count > best) {
+            second = best;
+            best = visit_count;
+        } else if (visit_count > second) {
+            second = visit_count;
+        }
+    }
+    if (edges.size == 0) {
+        return true;
+    }
+    if (best == 0) {
+        // At least one simulation, so that there is a move to pick
+        return false;
+    }
+    if (edges.size == 1) {
+        return true;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= limits.hard_deadline) {
+        return true;
+    }
+    const bool contested = second * 2 > best;
+    if (now >= limits.soft_deadline && !contested) {
+        return true;
+    }
+    const std::chrono::duration<double> elapsed = now - start;
+    if (!limits.stop_early || simulations == 0 || elapsed.count() <= 0) {
+        return false;
+    }
+    // Simulations in flight count towards the rate, which errs on the side of searching on
+    const std::chrono::duration<double> time_left = (contested ? limits.hard_deadline : limits.soft_deadline) - now;
+    double simulations_left = simulations / elapsed.count() * time_left.count();
+    if (limits.max_simulations > 0) {
+        simulations_left = std::min<double>(simulations_left, limits.max_simulations - simulations);
+    }
+    return best - second > simulations_left;
+}
+
+void SurakartaAlphazeroMCTS::RunWorkers(int thread_count, const std::function<bool()>& next) {
+    const size_t node_count = arena_->NodeCount();
+    std::atomic<int> simulations(0);
+    std::atomic<int> max_depth(0);
+    const auto work = [this, &next, &simulations, &max_depth]() {
+        // Each worker walks the tree on its own copy of the position
+        auto context = SearchContext(*board_, *game_info_, my_color_, transposition_table_ != nullptr);
+        int worker_simulations = 0;
+        while (next()) {
+            SimulateAndReturnValue(root_, context);
+            worker_simulations++;
+        }
+        simulations += worker_simulations;
+        int depth = max_depth.load();
+        while (context.max_depth > depth && !max_depth.compare_exchange_weak(depth, context.max_depth)) {
+        }
+    };
+    if (thread_count <= 1) {
+        work();
+    } else {
+        std::vector<std::exception_ptr> exceptions(thread_count);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++) {
+            threads.emplace_back([&work, &exceptions, i]() {
+                try {
+                    work();
+                } catch (...) {
+                    exceptions[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (auto& exception : exceptions) {
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+    }
+    auto& metrics = SurakartaAlphazeroMetrics::Global();
+    if (metrics.Enabled()) {
+        const size_t nodes_allocated = arena_->NodeCount() - node_count;
+        metrics.Add(SurakartaAlphazeroMetrics::Counter::SEARCHES);
+        metrics.Add(SurakartaAlphazeroMetrics::Counter::SIMULATIONS, simulations);
+        metrics.Add(SurakartaAlphazeroMetrics::Counter::NODES_ALLOCATED, nodes_allocated);
+        metrics.Observe(SurakartaAlphazeroMetrics::Histogram::NODES_PER_SEARCH, nodes_allocated);
+        metrics.Observe(SurakartaAlphazeroMetrics::Histogram::SEARCH_DEPTH, max_depth);
+    }
+}
+
+std::pair<SurakartaAlphazeroMCTS::NodeIndex, int> SurakartaAlphazeroMCTS::FindCurrentPosition(
+    NodeIndex node, SearchContext& context, const SurakartaAlphazeroPosition& current_position, int max_depth) {
+    const auto edges = arena_->GetEdges(arena_->GetNode(node));
+    for (int i = 0; i < edges.size; i++) {
+        const auto child = edges.children[i].load();
+        if (child == SurakartaAlphazeroMCTSArena::kNoNode)
+            continue;
+        SurakartaAlphazeroMoveGenerator::ApplyMoveGuard guard(context.state, edges.moves[i]);
+        if (context.state.position == current_position) {
+            return {child, 1};
+        }
+        if (max_depth > 1) {
+            const auto found = FindCurrentPosition(child, context, current_position, max_depth - 1);
+            if (found.first != SurakartaAlphazeroMCTSArena::kNoNode) {
+                return {found.first, found.second + 1};
+            }
+        }
+    }
+    return {SurakartaAlphazeroMCTSArena::kNoNode, 0};
+}
+
+bool SurakartaAlphazeroMCTS::PromoteToCurrentPosition(int max_depth) {
+    const auto current_position = SurakartaAlphazeroPosition(*board_, *game_info_);
+    if (root_state_.position == current_position) {
+        return true;
+    }
+    // Walk the tree from the old root position, the live board has already moved on
+    auto context = SearchContext(root_state_, my_color_, transposition_table_ != nullptr);
+    const auto found = FindCurrentPosition(root_, context, current_position, max_depth);
+    if (found.first == SurakartaAlphazeroMCTSArena::kNoNode) {
+        return false;
+    }
+    // Keep the subtree by copying it into the spare arena, then free the old tree in one go
+    spare_arena_->Reset();
+    root_ = spare_arena_->CopySubtree(*arena_, found.first);
+    std::swap(arena_, spare_arena_);
+    spare_arena_->Reset();
+    if (found.second % 2 == 1) {
+        my_color_ = ReverseColor(my_color_);
+    }
+    root_state_ = SurakartaAlphazeroMoveGenerator::State(*board_, *game_info_);
+
+    // The visit that expanded the node did not go to any of its children; drop it so that the
+    // root count stays the sum of its children's counts, as CalculateMoveProbabilities expects.
+    auto& root = arena_->GetNode(root_);
+    const auto edges = arena_->GetEdges(root);
+    root.simulation_count = std::accumulate(edges.visit_counts, edges.visit_counts + edges.size, 0);
+    return true;
 }
 
 SurakartaAlphazeroNeuralNetworkBase::TrainEntry SurakartaAlphazeroMCTS::GetTrainEntriesWithoutValue() const {
     auto ret = SurakartaAlphazeroNeuralNetworkBase::TrainEntry();
     ret.input = std::make_unique<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput>();
-    ret.input->board = std::make_unique<SurakartaBoard>(*board_);
-    ret.input->game_info = *game_info_;
+    ret.input->position = SurakartaAlphazeroPosition(*board_, *game_info_);
     ret.input->my_color = my_color_;
     ret.output = std::make_unique<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput>();
     ret.output->current_status_value = 0.0f;
     ret.output->move_probabilities = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::MoveWithProbability>>();
+    const auto& root = arena_->GetNode(root_);
+    const auto edges = arena_->GetEdges(root);
     int simulation_count_debug = 0;
-    for (int i = 0; i < root_->possible_moves_.size(); i++) {
-        if (root_->childs_[i] != nullptr) {
+    for (int i = 0; i < edges.size; i++) {
+        if (edges.visit_counts[i] > 0) {
             auto move_with_probability = SurakartaAlphazeroNeuralNetworkBase::MoveWithProbability();
-            move_with_probability.move = root_->possible_moves_[i];
-            move_with_probability.probability = static_cast<float>(root_->childs_[i]->simulation_count_) / root_->simulation_count_;
+            move_with_probability.move = edges.moves[i];
+            move_with_probability.probability = static_cast<float>(edges.visit_counts[i]) / root.simulation_count;
             ret.output->move_probabilities->push_back(move_with_probability);
-            simulation_count_debug += root_->childs_[i]->simulation_count_;
+            simulation_count_debug += edges.visit_counts[i];
         }
     }
-    assert(simulation_count_debug == root_->simulation_count_);
+    assert(simulation_count_debug == root.simulation_count);
     return ret;
 }
 
@@ -248,7 +460,9 @@ SurakartaAlphazeroNeuralNetworkBase::TrainEntry SurakartaAlphazeroMCTS::GetTrain
         return -v
 */
 // This method do not return the negative value of the value of the current status as the original code does.
-float SurakartaAlphazeroMCTS::SimulateAndReturnValue(Node& node) {
+// Edge statistics are kept from the view of the player choosing the edge, so a parent negates
+// the value returned by its child before backing it up.
+float SurakartaAlphazeroMCTS::SimulateAndReturnValue(NodeIndex node_index, SearchContext& context) {
     /*
     if (s, a) in self.Qsa:
         self.Qsa[(s, a)] = (self.Nsa[(s, a)] * self.Qsa[(s, a)] + v) / (self.Nsa[(s, a)] + 1)
@@ -260,13 +474,15 @@ float SurakartaAlphazeroMCTS::SimulateAndReturnValue(Node& node) {
     self.Ns[s] += 1
     return -v
     */
-#define RETURN_VALUE(value)                                                                  \
-    {                                                                                        \
-        node.Q = (node.simulation_count_ * node.Q + (value)) / (node.simulation_count_ + 1); \
-        node.simulation_count_++;                                                            \
-        return (value);                                                                      \
+#define RETURN_VALUE(value)      \
+    {                            \
+        node.simulation_count++; \
+        return (value);          \
     }
 
+    auto& node = arena_->GetNode(node_index);
+    const auto edges = arena_->GetEdges(node);
+
     /*
     s = self.game.stringRepresentation(canonicalBoard)
     if s not in self.Es:
@@ -275,15 +491,15 @@ float SurakartaAlphazeroMCTS::SimulateAndReturnValue(Node& node) {
         # terminal node
         return -self.Es[s]
     */
-    if (game_info_->IsEnd()) {
-        if (game_info_->Winner() == my_color_)
+    if (context.state.is_end) {
+        if (context.state.winner == context.my_color)
             RETURN_VALUE(1.0f)
-        else if (game_info_->Winner() == ReverseColor(my_color_))
+        else if (context.state.winner == ReverseColor(context.my_color))
             RETURN_VALUE(-1.0f)
         else
             RETURN_VALUE(0.0f)
     }
-    if (node.possible_moves_.size() == 0) {
+    if (edges.size == 0) {
         RETURN_VALUE(-1.0f)  // cannot move, thus lose
     }
 
@@ -311,16 +527,20 @@ float SurakartaAlphazeroMCTS::SimulateAndReturnValue(Node& node) {
 
     v = self.search(next_s)
     */
+    // Every in-flight simulation through an edge counts as a lost visit until it is backed up,
+    // so concurrent workers prefer other branches.
+    const float sqrt_simulation_count = std::sqrt(static_cast<float>(node.simulation_count.load(std::memory_order_relaxed)));
     float current_best = -std::numeric_limits<float>::infinity();
-    int best_move_index;
-    for (int i = 0; i < node.possible_moves_.size(); i++) {
+    int best_move_index = 0;
+    for (int i = 0; i < edges.size; i++) {
+        const int visit_count = edges.visit_counts[i].load(std::memory_order_relaxed) + edges.virtual_losses[i].load(std::memory_order_relaxed);
         float u;
-        if (node.childs_[i] != nullptr) {
-            u = node.childs_[i]->Q +
-                cpuct_ * node.neural_network_predicted_move_probabilities_[i] * std::sqrt(node.simulation_count_) /
-                    (1 + node.childs_[i]->simulation_count_);
+        if (visit_count > 0) {
+            const float value_sum = edges.value_sums[i].load(std::memory_order_relaxed) - edges.virtual_losses[i].load(std::memory_order_relaxed);
+            u = value_sum / visit_count +
+                cpuct_ * edges.priors[i] * sqrt_simulation_count / (1 + visit_count);
         } else {
-            u = cpuct_ * node.neural_network_predicted_move_probabilities_[i] * std::sqrt(node.simulation_count_);
+            u = cpuct_ * edges.priors[i] * sqrt_simulation_count;
         }
         if (u > current_best) {
             current_best = u;
@@ -328,14 +548,38 @@ float SurakartaAlphazeroMCTS::SimulateAndReturnValue(Node& node) {
         }
     }
 
-    SurakartaTemporarilyApplyMoveWithGameInfoGuardUtil guard(board_, game_info_, node.possible_moves_[best_move_index]);
-    my_color_ = ReverseColor(my_color_);
-    if (node.childs_[best_move_index] == nullptr) {
-        node.childs_[best_move_index] = CreateNode();
-        node.childs_[best_move_index]->simulation_count_++;
-        RETURN_VALUE(-node.childs_[best_move_index]->neural_network_predicted_value_)
+    edges.virtual_losses[best_move_index]++;
+    const auto hash = context.hash;
+    float value;
+    {
+        SurakartaAlphazeroMoveGenerator::ApplyMoveGuard guard(context.state, edges.moves[best_move_index]);
+        if (transposition_table_ != nullptr) {
+            context.hash = SurakartaAlphazeroZobristHash::Update(context.hash, guard.Before().position, context.state.position);
+        }
+        context.my_color = ReverseColor(context.my_color);
+        context.depth++;
+        context.max_depth = std::max(context.max_depth, context.depth);
+        auto child = edges.children[best_move_index].load(std::memory_order_acquire);
+        if (child == SurakartaAlphazeroMCTSArena::kNoNode) {
+            const auto created = CreateNode(context);
+            auto& created_node = arena_->GetNode(created);
+            created_node.simulation_count = 1;
+            value = -created_node.predicted_value;
+            if (!edges.children[best_move_index].compare_exchange_strong(child, created, std::memory_order_acq_rel)) {
+                // Another worker expanded the same child first. The node we created stays unused in the
+                // arena until the next reset; count this evaluation as a visit of the published one.
+                arena_->GetNode(child).simulation_count++;
+            }
+        } else {
+            value = -SimulateAndReturnValue(child, context);
+        }
+        context.depth--;
+        context.my_color = ReverseColor(context.my_color);
     }
-    const auto value = -SimulateAndReturnValue(*node.childs_[best_move_index]);
-    my_color_ = ReverseColor(my_color_);
+    context.hash = hash;
+    AtomicAdd(edges.value_sums[best_move_index], value);
+    edges.visit_counts[best_move_index]++;
+    edges.virtual_losses[best_move_index]--;
     RETURN_VALUE(value)
+#undef RETURN_VALUE
 }
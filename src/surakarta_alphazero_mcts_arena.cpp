@@ -0,0 +1,96 @@
+#include "surakarta_alphazero_mcts_arena.h"
+#include <stdexcept>
+
+SurakartaAlphazeroMCTSArena::SurakartaAlphazeroMCTSArena()
+    : node_blocks_(std::make_unique<std::unique_ptr<NodeBlock>[]>(kMaxBlocks)),
+      edge_blocks_(std::make_unique<std::unique_ptr<EdgeBlock>[]>(kMaxBlocks)),
+      node_count_(0),
+      edge_count_(0) {}
+
+SurakartaAlphazeroMCTSArena::~SurakartaAlphazeroMCTSArena() {}
+
+SurakartaAlphazeroMCTSArena::NodeIndex SurakartaAlphazeroMCTSArena::AllocateNode(uint32_t edge_count) {
+    if (edge_count > kEdgeBlockSize)
+        throw std::runtime_error("SurakartaAlphazeroMCTSArena: too many edges for one node");
+    size_t node_index;
+    size_t edge_begin;
+    {
+        std::lock_guard<std::mutex> lock(allocation_mutex_);
+        node_index = node_count_;
+        edge_begin = edge_count_;
+        // The edges of a node never straddle two blocks
+        if (edge_begin % kEdgeBlockSize + edge_count > kEdgeBlockSize) {
+            edge_begin += kEdgeBlockSize - edge_begin % kEdgeBlockSize;
+        }
+        if (node_index / kNodeBlockSize >= kMaxBlocks || (edge_begin + edge_count) / kEdgeBlockSize >= kMaxBlocks)
+            throw std::runtime_error("SurakartaAlphazeroMCTSArena: out of blocks");
+        if (node_blocks_[node_index / kNodeBlockSize] == nullptr) {
+            node_blocks_[node_index / kNodeBlockSize] = std::unique_ptr<NodeBlock>(new NodeBlock);
+        }
+        if (edge_count > 0 && edge_blocks_[edge_begin / kEdgeBlockSize] == nullptr) {
+            edge_blocks_[edge_begin / kEdgeBlockSize] = std::unique_ptr<EdgeBlock>(new EdgeBlock);
+        }
+        node_count_ = node_index + 1;
+        edge_count_ = edge_begin + edge_count;
+    }
+
+    auto& node = GetNode(static_cast<NodeIndex>(node_index));
+    node.edge_begin = static_cast<EdgeIndex>(edge_begin);
+    node.edge_count = edge_count;
+    node.simulation_count.store(0, std::memory_order_relaxed);
+    node.predicted_value = 0;
+    const auto edges = GetEdges(node);
+    for (uint32_t i = 0; i < edges.size; i++) {
+        edges.priors[i] = 0;
+        edges.visit_counts[i].store(0, std::memory_order_relaxed);
+        edges.value_sums[i].store(0, std::memory_order_relaxed);
+        edges.virtual_losses[i].store(0, std::memory_order_relaxed);
+        edges.children[i].store(kNoNode, std::memory_order_relaxed);
+    }
+    return static_cast<NodeIndex>(node_index);
+}
+
+SurakartaAlphazeroMCTSArena::EdgeRange SurakartaAlphazeroMCTSArena::GetEdges(const Node& node) const {
+    if (node.edge_count == 0) {
+        return {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0};
+    }
+    auto& block = *edge_blocks_[node.edge_begin / kEdgeBlockSize];
+    const auto offset = node.edge_begin % kEdgeBlockSize;
+    return {
+        block.moves + offset,
+        block.priors + offset,
+        block.visit_counts + offset,
+        block.value_sums + offset,
+        block.virtual_losses + offset,
+        block.children + offset,
+        node.edge_count,
+    };
+}
+
+SurakartaAlphazeroMCTSArena::NodeIndex SurakartaAlphazeroMCTSArena::CopySubtree(
+    const SurakartaAlphazeroMCTSArena& source, NodeIndex node) {
+    const auto& source_node = source.GetNode(node);
+    const auto source_edges = source.GetEdges(source_node);
+    const auto copy = AllocateNode(source_node.edge_count);
+    auto& copy_node = GetNode(copy);
+    copy_node.simulation_count = source_node.simulation_count.load();
+    copy_node.predicted_value = source_node.predicted_value;
+    const auto copy_edges = GetEdges(copy_node);
+    for (uint32_t i = 0; i < source_edges.size; i++) {
+        copy_edges.moves[i] = source_edges.moves[i];
+        copy_edges.priors[i] = source_edges.priors[i];
+        copy_edges.visit_counts[i] = source_edges.visit_counts[i].load();
+        copy_edges.value_sums[i] = source_edges.value_sums[i].load();
+        const auto child = source_edges.children[i].load();
+        if (child != kNoNode) {
+            copy_edges.children[i] = CopySubtree(source, child);
+        }
+    }
+    return copy;
+}
+
+void SurakartaAlphazeroMCTSArena::Reset() {
+    std::lock_guard<std::mutex> lock(allocation_mutex_);
+    node_count_ = 0;
+    edge_count_ = 0;
+}
@@ -0,0 +1,311 @@
+#include "surakarta_alphazero_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+static constexpr uint64_t kUnset = ~uint64_t(0);  // Bits of a NaN, never stored by Set()
+
+/// @brief The number of bits needed to write value, 0 for 0.
+static int BitLength(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index) + 1;
+#else
+    return 64 - __builtin_clzll(value);
+#endif
+}
+
+static int64_t Now() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+SurakartaAlphazeroMetrics::SurakartaAlphazeroMetrics() : enabled_(false), interval_start_(Now()) {
+    for (auto& counter : counters_) {
+        counter = 0;
+    }
+    for (auto& histogram : histograms_) {
+        for (auto& bucket : histogram.buckets) {
+            bucket = 0;
+        }
+        histogram.sum = 0;
+        histogram.max = 0;
+    }
+    for (auto& gauge : gauges_) {
+        gauge = kUnset;
+    }
+}
+
+SurakartaAlphazeroMetrics& SurakartaAlphazeroMetrics::Global() {
+    static SurakartaAlphazeroMetrics metrics;
+    return metrics;
+}
+
+void SurakartaAlphazeroMetrics::Observe(Histogram histogram, uint64_t value) {
+    auto& data = histograms_[static_cast<int>(histogram)];
+    data.buckets[std::min(BitLength(value), kBucketCount - 1)].fetch_add(1, std::memory_order_relaxed);
+    data.sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = data.max.load(std::memory_order_relaxed);
+    while (value > max && !data.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void SurakartaAlphazeroMetrics::Set(Gauge gauge, double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    gauges_[static_cast<int>(gauge)].store(bits, std::memory_order_relaxed);
+}
+
+SurakartaAlphazeroMetrics::Report SurakartaAlphazeroMetrics::Collect() {
+    Report report;
+    const int64_t now = Now();
+    const int64_t start = interval_start_.exchange(now);
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::duration(now - start)).count();
+    for (int i = 0; i < static_cast<int>(Counter::COUNT); i++) {
+        report.counters[i] = counters_[i].exchange(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < static_cast<int>(Histogram::COUNT); i++) {
+        auto& data = histograms_[i];
+        uint64_t buckets[kBucketCount];
+        uint64_t count = 0;
+        for (int b = 0; b < kBucketCount; b++) {
+            buckets[b] = data.buckets[b].exchange(0, std::memory_order_relaxed);
+            count += buckets[b];
+        }
+        const uint64_t sum = data.sum.exchange(0, std::memory_order_relaxed);
+        const uint64_t max = data.max.exchange(0, std::memory_order_relaxed);
+        // The upper bound of the bucket holding a rank, but never beyond the largest value seen
+        const auto percentile = [&](double fraction) -> uint64_t {
+            const uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * count));
+            uint64_t seen = 0;
+            for (int b = 0; b < kBucketCount; b++) {
+                seen += buckets[b];
+                if (seen >= rank && seen > 0) {
+                    const uint64_t upper = b == 0 ? 0 : (uint64_t(1) << b) - 1;
+                    return std::min(upper, max);
+                }
+            }
+            return max;
+        };
+        auto& summary = report.histograms[i];
+        summary.count = count;
+        summary.mean = count > 0 ? static_cast<double>(sum) / count : 0;
+        summary.p50 = count > 0 ? percentile(0.5) : 0;
+        summary.p90 = count > 0 ? percentile(0.9) : 0;
+        summary.p99 = count > 0 ? percentile(0.99) : 0;
+        summary.max = max;
+    }
+    for (int i = 0; i < static_cast<int>(Gauge::COUNT); i++) {
+        const uint64_t bits = gauges_[i].exchange(kUnset, std::memory_order_relaxed);
+        report.gauge_set[i] = bits != kUnset;
+        std::memcpy(&report.gauges[i], &bits, sizeof(bits));
+        if (!report.gauge_set[i]) {
+            report.gauges[i] = 0;
+        }
+    }
+    return report;
+}
+
+double SurakartaAlphazeroMetrics::Report::SimulationsPerSecond() const {
+    const uint64_t self_play_microseconds = Get(Counter::SELF_PLAY_MICROSECONDS);
+    const double elapsed = self_play_microseconds > 0 ? self_play_microseconds / 1e6 : seconds;
+    return elapsed > 0 ? Get(Counter::SIMULATIONS) / elapsed : 0;
+}
+
+double SurakartaAlphazeroMetrics::Report::TrainSamplesPerSecond() const {
+    const uint64_t microseconds = Get(Counter::TRAIN_MICROSECONDS);
+    return microseconds > 0 ? Get(Counter::TRAIN_SAMPLES) / (microseconds / 1e6) : 0;
+}
+
+double SurakartaAlphazeroMetrics::Report::BatchFillRatio() const {
+    const uint64_t capacity = Get(Counter::BATCH_CAPACITY);
+    return capacity > 0 ? static_cast<double>(Get(Counter::BATCHED_POSITIONS)) / capacity : 0;
+}
+
+std::string SurakartaAlphazeroMetrics::Report::ToJson(int iteration) const {
+    std::ostringstream json;
+    json << "{\"iteration\":" << iteration << ",\"seconds\":" << seconds
+         << ",\"simulations_per_second\":" << SimulationsPerSecond()
+         << ",\"train_samples_per_second\":" << TrainSamplesPerSecond()
+         << ",\"batch_fill_ratio\":" << BatchFillRatio() << ",\"counters\":{";
+    for (int i = 0; i < static_cast<int>(Counter::COUNT); i++) {
+        json << (i > 0 ? "," : "") << "\"" << Name(static_cast<Counter>(i)) << "\":" << counters[i];
+    }
+    json << "},\"histograms\":{";
+    for (int i = 0; i < static_cast<int>(Histogram::COUNT); i++) {
+        const auto& summary = histograms[i];
+        json << (i > 0 ? "," : "") << "\"" << Name(static_cast<Histogram>(i)) << "\":{\"count\":" << summary.count
+             << ",\"mean\":" << summary.mean << ",\"p50\":" << summary.p50 << ",\"p90\":" << summary.p90
+             << ",\"p99\":" << summary.p99 << ",\"max\":" << summary.max << "}";
+    }
+    json << "},\"gauges\":{";
+    for (int i = 0; i < static_cast<int>(Gauge::COUNT); i++) {
+        json << (i > 0 ? "," : "") << "\"" << Name(static_cast<Gauge>(i)) << "\":";
+        if (gauge_set[i]) {
+            json << gauges[i];
+        } else {
+            json << "null";
+        }
+    }
+    json << "}}";
+    return json.str();
+}
+
+std::string SurakartaAlphazeroMetrics::Report::ToPrometheus(int iteration) const {
+    // Every value covers the last interval only, so they are all gauges
+    std::ostringstream text;
+    const auto gauge = [&text](const std::string& name, double value) {
+        text << "# TYPE surakarta_alphazero_" << name << " gauge\n"
+             << "surakarta_alphazero_" << name << " " << value << "\n";
+    };
+    gauge("iteration", iteration);
+    gauge("interval_seconds", seconds);
+    gauge("simulations_per_second", SimulationsPerSecond());
+    gauge("train_samples_per_second", TrainSamplesPerSecond());
+    gauge("batch_fill_ratio", BatchFillRatio());
+    for (int i = 0; i < static_cast<int>(Counter::COUNT); i++) {
+        gauge(Name(static_cast<Counter>(i)), static_cast<double>(counters[i]));
+    }
+    for (int i = 0; i < static_cast<int>(Histogram::COUNT); i++) {
+        const std::string name = std::string("surakarta_alphazero_") + Name(static_cast<Histogram>(i));
+        const auto& summary = histograms[i];
+        text << "# TYPE " << name << " summary\n"
+             << name << "{quantile=\"0.5\"} " << summary.p50 << "\n"
+             << name << "{quantile=\"0.9\"} " << summary.p90 << "\n"
+             << name << "{quantile=\"0.99\"} " << summary.p99 << "\n"
+             << name << "{quantile=\"1\"} " << summary.max << "\n"
+             << name << "_sum " << summary.mean * summary.count << "\n"
+             << name << "_count " << summary.count << "\n";
+    }
+    for (int i = 0; i < static_cast<int>(Gauge::COUNT); i++) {
+        if (gauge_set[i]) {
+            gauge(Name(static_cast<Gauge>(i)), gauges[i]);
+        }
+    }
+    return text.str();
+}
+
+void SurakartaAlphazeroMetrics::Write(const std::string& path, Format format, const Report& report, int iteration) {
+    if (format == Format::JSON) {
+        std::ofstream file(path, std::ios::app);
+        file << report.ToJson(iteration) << "\n";
+        if (!file) {
+            throw std::runtime_error("Cannot write metrics to " + path);
+        }
+        return;
+    }
+    // Replace the file at once, so that a scraper never reads half of it
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::trunc);
+        file << report.ToPrometheus(iteration);
+        if (!file) {
+            throw std::runtime_error("Cannot write metrics to " + temporary_path);
+        }
+    }
+    std::filesystem::rename(temporary_path, path);
+}
+
+SurakartaAlphazeroMetrics::ScopedTimer::ScopedTimer(int counter, int histogram)
+    : enabled_(Global().Enabled()),
+      counter_(counter),
+      histogram_(histogram),
+      start_(enabled_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+
+SurakartaAlphazeroMetrics::ScopedTimer::~ScopedTimer() {
+    if (!enabled_) {
+        return;
+    }
+    const uint64_t microseconds =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count();
+    if (counter_ >= 0) {
+        Global().Add(static_cast<Counter>(counter_), microseconds);
+    } else {
+        Global().Observe(static_cast<Histogram>(histogram_), microseconds);
+    }
+}
+
+const char* SurakartaAlphazeroMetrics::Name(Counter counter) {
+    switch (counter) {
+        case Counter::SIMULATIONS:
+            return "simulations";
+        case Counter::SEARCHES:
+            return "searches";
+        case Counter::NODES_ALLOCATED:
+            return "nodes_allocated";
+        case Counter::PREDICT_CALLS:
+            return "predict_calls";
+        case Counter::BATCHES:
+            return "batches";
+        case Counter::BATCHED_POSITIONS:
+            return "batched_positions";
+        case Counter::BATCH_CAPACITY:
+            return "batch_capacity";
+        case Counter::SELF_PLAY_MICROSECONDS:
+            return "self_play_microseconds";
+        case Counter::TRAIN_SAMPLES:
+            return "train_samples";
+        case Counter::TRAIN_MICROSECONDS:
+        default:
+            return "train_microseconds";
+    }
+}
+
+const char* SurakartaAlphazeroMetrics::Name(Histogram histogram) {
+    switch (histogram) {
+        case Histogram::PREDICT_LATENCY_US:
+            return "predict_latency_us";
+        case Histogram::MODEL_LOCK_WAIT_US:
+            return "model_lock_wait_us";
+        case Histogram::SEARCH_DEPTH:
+            return "search_depth";
+        case Histogram::NODES_PER_SEARCH:
+            return "nodes_per_search";
+        case Histogram::MOVE_GENERATION_NS:
+        default:
+            return "move_generation_ns";
+    }
+}
+
+const char* SurakartaAlphazeroMetrics::Name(Gauge gauge) {
+    switch (gauge) {
+        case Gauge::POLICY_LOSS:
+            return "policy_loss";
+        case Gauge::VALUE_LOSS:
+        default:
+            return "value_loss";
+    }
+}
+
+const char* SurakartaAlphazeroMetrics::FormatName(Format format) {
+    switch (format) {
+        case Format::PROMETHEUS:
+            return "prometheus";
+        case Format::JSON:
+        default:
+            return "json";
+    }
+}
+
+bool SurakartaAlphazeroMetrics::ParseFormat(const std::string& name, Format& format) {
+    for (const auto candidate : {Format::JSON, Format::PROMETHEUS}) {
+        if (name == FormatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
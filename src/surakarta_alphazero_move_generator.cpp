@@ -0,0 +1,240 @@
+#include "surakarta_alphazero_move_generator.h"
+#include <algorithm>
+#include <vector>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr int kCellCount = SurakartaAlphazeroMoveGenerator::kCellCount;
+constexpr int kCircuitCount = BOARD_SIZE / 2 - 1;  // Circuit k runs along rows and columns k and BOARD_SIZE - 1 - k
+constexpr int kCircuitLength = 4 * BOARD_SIZE;
+constexpr int kMaxRaysPerCell = 4;  // A cell is on at most two circuit lines, and a ray runs each way along them
+
+/// @brief The cells a capture can run through from one cell, one lap along a circuit in one direction.
+struct Ray {
+    uint8_t cells[kCircuitLength];
+    bool after_arc[kCircuitLength];  // Whether the run has gone through a corner arc when it reaches the cell
+};
+
+struct Tables {
+    uint64_t neighbours[kCellCount];
+    Ray rays[kCellCount][kMaxRaysPerCell];
+    int ray_count[kCellCount];
+
+    Tables() : neighbours(), ray_count() {
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            for (int y = 0; y < BOARD_SIZE; y++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    for (int dy = -1; dy <= 1; dy++) {
+                        const int nx = x + dx;
+                        const int ny = y + dy;
+                        if ((dx != 0 || dy != 0) && nx >= 0 && ny >= 0 && nx < BOARD_SIZE && ny < BOARD_SIZE) {
+                            neighbours[x * BOARD_SIZE + y] |= SurakartaAlphazeroPosition::Bit(nx, ny);
+                        }
+                    }
+                }
+            }
+        }
+        for (int k = 1; k <= kCircuitCount; k++) {
+            // Four lines joined by the arcs around the corners: each line ends next to where the next begins
+            uint8_t circuit[kCircuitLength];
+            int length = 0;
+            for (int x = 0; x < BOARD_SIZE; x++)
+                circuit[length++] = x * BOARD_SIZE + k;
+            for (int y = 0; y < BOARD_SIZE; y++)
+                circuit[length++] = (BOARD_SIZE - 1 - k) * BOARD_SIZE + y;
+            for (int x = BOARD_SIZE - 1; x >= 0; x--)
+                circuit[length++] = x * BOARD_SIZE + (BOARD_SIZE - 1 - k);
+            for (int y = BOARD_SIZE - 1; y >= 0; y--)
+                circuit[length++] = k * BOARD_SIZE + y;
+            for (int start = 0; start < kCircuitLength; start++) {
+                for (const int direction : {1, -1}) {
+                    auto& ray = rays[circuit[start]][ray_count[circuit[start]]++];
+                    bool after_arc = false;
+                    int index = start;
+                    for (int step = 0; step < kCircuitLength; step++) {
+                        const int next = (index + direction + kCircuitLength) % kCircuitLength;
+                        // Crossing from the end of a line to the start of the next one goes through an arc
+                        after_arc |= direction == 1 ? next % BOARD_SIZE == 0 : index % BOARD_SIZE == 0;
+                        index = next;
+                        ray.cells[step] = circuit[index];
+                        ray.after_arc[step] = after_arc;
+                    }
+                }
+            }
+        }
+    }
+};
+
+const Tables& GetTables() {
+    static const Tables tables;
+    return tables;
+}
+
+int PopCount(uint64_t bits) {
+    int count = 0;
+    for (; bits != 0; bits &= bits - 1) {
+        count++;
+    }
+    return count;
+}
+
+int LowestBit(uint64_t bits) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+SurakartaPosition CellPosition(int cell) {
+    return SurakartaPosition(cell / BOARD_SIZE, cell % BOARD_SIZE);
+}
+
+std::string MoveToString(const SurakartaMove& move) {
+    return "(" + std::to_string(move.from.x) + "," + std::to_string(move.from.y) + ")->(" +
+           std::to_string(move.to.x) + "," + std::to_string(move.to.y) + ")";
+}
+
+bool MoveLess(const SurakartaMove& a, const SurakartaMove& b) {
+    if (a.from.x != b.from.x)
+        return a.from.x < b.from.x;
+    if (a.from.y != b.from.y)
+        return a.from.y < b.from.y;
+    if (a.to.x != b.to.x)
+        return a.to.x < b.to.x;
+    return a.to.y < b.to.y;
+}
+
+bool SameState(const SurakartaAlphazeroMoveGenerator::State& a, const SurakartaAlphazeroMoveGenerator::State& b) {
+    return a.position == b.position && a.is_end == b.is_end && a.winner == b.winner;
+}
+
+}  // namespace
+
+int SurakartaAlphazeroMoveGenerator::MoveList::Count() const {
+    int count = 0;
+    for (int i = 0; i < piece_count; i++) {
+        count += PopCount(targets[i]);
+    }
+    return count;
+}
+
+void SurakartaAlphazeroMoveGenerator::MoveList::Write(SurakartaMove* moves) const {
+    for (int i = 0; i < piece_count; i++) {
+        const auto from_position = CellPosition(from[i]);
+        for (uint64_t bits = targets[i]; bits != 0; bits &= bits - 1) {
+            *moves++ = SurakartaMove(from_position, CellPosition(LowestBit(bits)), color);
+        }
+    }
+}
+
+void SurakartaAlphazeroMoveGenerator::GenerateMoves(const SurakartaAlphazeroPosition& position,
+                                                    PieceColor color,
+                                                    MoveList& moves) {
+    const auto& tables = GetTables();
+    const uint64_t mine = position.Pieces(color);
+    const uint64_t theirs = position.Pieces(ReverseColor(color));
+    const uint64_t occupied = position.black | position.white;
+    moves.color = color;
+    moves.piece_count = 0;
+    for (uint64_t pieces = mine; pieces != 0; pieces &= pieces - 1) {
+        const int from = LowestBit(pieces);
+        uint64_t targets = tables.neighbours[from] & ~occupied;
+        // The moving piece leaves its cell, so a run may go through it
+        const uint64_t blockers = occupied & ~(uint64_t(1) << from);
+        for (int r = 0; r < tables.ray_count[from]; r++) {
+            const auto& ray = tables.rays[from][r];
+            for (int step = 0; step < kCircuitLength; step++) {
+                const uint64_t bit = uint64_t(1) << ray.cells[step];
+                if ((blockers & bit) == 0) {
+                    continue;
+                }
+                if ((theirs & bit) != 0 && ray.after_arc[step]) {
+                    targets |= bit;
+                }
+                break;
+            }
+        }
+        if (targets != 0) {
+            moves.from[moves.piece_count] = static_cast<uint8_t>(from);
+            moves.targets[moves.piece_count] = targets;
+            moves.piece_count++;
+        }
+    }
+}
+
+void SurakartaAlphazeroMoveGenerator::Make(State& state, const SurakartaMove& move) {
+    auto& position = state.position;
+    const uint64_t from = SurakartaAlphazeroPosition::Bit(move.from.x, move.from.y);
+    const uint64_t to = SurakartaAlphazeroPosition::Bit(move.to.x, move.to.y);
+    const bool black_moves = (position.black & from) != 0;
+    uint64_t& mine = black_moves ? position.black : position.white;
+    uint64_t& theirs = black_moves ? position.white : position.black;
+    const bool capture = (theirs & to) != 0;
+    mine = (mine & ~from) | to;
+    theirs &= ~to;
+    if (capture) {
+        position.last_captured_round = position.num_round;
+    }
+    const auto mover = black_moves ? PieceColor::BLACK : PieceColor::WHITE;
+    if (theirs == 0) {
+        state.is_end = true;
+        state.winner = mover;
+    } else if (position.num_round - position.last_captured_round >= state.max_no_capture_round) {
+        // No capture for too long: the side with more pieces wins
+        const int mine_count = PopCount(mine);
+        const int theirs_count = PopCount(theirs);
+        state.is_end = true;
+        state.winner = mine_count > theirs_count   ? mover
+                       : mine_count < theirs_count ? ReverseColor(mover)
+                                                   : PieceColor::NONE;
+    }
+    position.current_player = ReverseColor(position.current_player);
+    if (position.current_player == PieceColor::BLACK) {
+        position.num_round++;
+    }
+}
+
+bool SurakartaAlphazeroMoveGenerator::CheckAgainstCore(const SurakartaBoard& board,
+                                                       const SurakartaGameInfo& game_info,
+                                                       std::string& difference) {
+    const auto color = game_info.current_player_;
+    auto board_copy = std::make_shared<SurakartaBoard>(board);
+    auto game_info_copy = std::make_shared<SurakartaGameInfo>(game_info);
+    SurakartaGetAllLegalMovesUtil legal_moves_util(board_copy);
+    auto expected = *legal_moves_util.GetAllLegalMoves(color);
+    const State state(board, game_info);
+    MoveList move_list;
+    GenerateMoves(state.position, color, move_list);
+    std::vector<SurakartaMove> actual(move_list.Count());
+    move_list.Write(actual.data());
+
+    std::sort(expected.begin(), expected.end(), MoveLess);
+    std::sort(actual.begin(), actual.end(), MoveLess);
+    for (size_t i = 0; i < std::max(expected.size(), actual.size()); i++) {
+        if (i >= actual.size() || (i < expected.size() && MoveLess(expected[i], actual[i]))) {
+            difference = "missing move " + MoveToString(expected[i]);
+            return false;
+        }
+        if (i >= expected.size() || MoveLess(actual[i], expected[i])) {
+            difference = "extra move " + MoveToString(actual[i]);
+            return false;
+        }
+    }
+
+    for (const auto& move : expected) {
+        SurakartaTemporarilyApplyMoveWithGameInfoGuardUtil guard(board_copy, game_info_copy, move);
+        auto after = state;
+        Make(after, move);
+        if (!SameState(after, State(*board_copy, *game_info_copy))) {
+            difference = "different state after " + MoveToString(move);
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,159 +1,859 @@
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include "surakarta_alphazero_metrics.h"
 #include "surakarta_alphazero_neural_network_factory.h"
+#include "surakarta_alphazero_neural_network_snapshot.h"
+#include "surakarta_alphazero_thread_placement.h"
 #include "tiny_dnn/tiny_dnn.h"
 
-constexpr int input_vector_size = BOARD_SIZE * BOARD_SIZE + 2;
-constexpr int output_vector_size_probabilities = BOARD_SIZE * BOARD_SIZE * BOARD_SIZE * BOARD_SIZE;
-constexpr int output_vector_size_value = 1;
-constexpr int hidden_layer_size = (input_vector_size + output_vector_size_probabilities + 1);
+static tiny_dnn::tensor_t ConvertInput(const SurakartaAlphazeroNeuralNetworkArchitecture& architecture,
+                                       SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput& input) {
+    tiny_dnn::vec_t vec(architecture.InputSize());
+    architecture.EncodeInput(input, vec.data());
+    return {vec};
+}
+
+/// @return first: probability_output, second: value_output
+static tiny_dnn::tensor_t ConvertOutput(
+    const SurakartaAlphazeroNeuralNetworkArchitecture& architecture,
+    const SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput& output) {
+    tiny_dnn::vec_t probability_output(architecture.PolicySize());
+    tiny_dnn::vec_t value_output(1);
+    architecture.EncodePolicyTarget(output, probability_output.data());
+    value_output[0] = output.current_status_value;
+    return {probability_output, value_output};
+}
 
-static tiny_dnn::tensor_t ConvertInput(SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput& input) {
-    tiny_dnn::vec_t vec(input_vector_size);
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            const auto color = (*input.board)[i][j]->GetColor();
-            vec[i * BOARD_SIZE + j] =
-                color == input.my_color                 ? 1.0f
-                : color == ReverseColor(input.my_color) ? -1.0f
-                                                        : 0.0f;
+/// @brief Softmax cross-entropy on the logits of a SOFTMAX policy head, MSE on the value head.
+/// tiny-dnn applies one loss to every output, so the heads are told apart by their size; a
+/// factorized head is two softmaxes, over the from cells and over the to cells.
+struct SoftmaxCrossEntropyMse {
+    static tiny_dnn::float_t f(const tiny_dnn::vec_t& y, const tiny_dnn::vec_t& t) {
+        if (y.size() == 1) {
+            return tiny_dnn::mse::f(y, t);
         }
+        tiny_dnn::float_t loss = 0;
+        ForEachSoftmax(y, [&](size_t begin, size_t end, const tiny_dnn::vec_t& p) {
+            for (size_t i = begin; i < end; i++) {
+                loss -= t[i] * std::log(std::max(p[i], tiny_dnn::float_t(1e-12)));
+            }
+        });
+        return loss;
     }
-    vec[input_vector_size - 2] = input.game_info.num_round_;
-    vec[input_vector_size - 1] = input.game_info.last_captured_round_;
-    return {vec};
+
+    static tiny_dnn::vec_t df(const tiny_dnn::vec_t& y, const tiny_dnn::vec_t& t) {
+        if (y.size() == 1) {
+            return tiny_dnn::mse::df(y, t);
+        }
+        tiny_dnn::vec_t d(y.size());
+        ForEachSoftmax(y, [&](size_t begin, size_t end, const tiny_dnn::vec_t& p) {
+            tiny_dnn::float_t target_sum = 0;
+            for (size_t i = begin; i < end; i++) {
+                target_sum += t[i];
+            }
+            for (size_t i = begin; i < end; i++) {
+                d[i] = p[i] * target_sum - t[i];
+            }
+        });
+        return d;
+    }
+
+    /// @brief Call body(begin, end, softmax of y) for each softmax the logits y are split into.
+    template <typename Function>
+    static void ForEachSoftmax(const tiny_dnn::vec_t& y, Function body) {
+        tiny_dnn::vec_t p(y);
+        const size_t group = y.size() == SurakartaAlphazeroNeuralNetworkArchitecture::kFactorizedPolicySize ? y.size() / 2 : y.size();
+        for (size_t begin = 0; begin < y.size(); begin += group) {
+            SurakartaAlphazeroNeuralNetworkArchitecture::Softmax(p.data() + begin, group);
+            body(begin, begin + group, p);
+        }
+    }
+};
+
+/// @brief Every trainable vector of the network, in layer order.
+static std::vector<tiny_dnn::vec_t*> AllWeights(tiny_dnn::network<tiny_dnn::graph>& network) {
+    std::vector<tiny_dnn::vec_t*> weights;
+    for (size_t i = 0; i < network.depth(); i++) {
+        for (auto* weight : network[i]->weights()) {
+            weights.push_back(weight);
+        }
+    }
+    return weights;
 }
 
-static SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput ConvertOutput(tiny_dnn::tensor_t output) {
-    const auto& probability_output = output[0];
-    const auto& value_output = output[1];
-    SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput ret;
-    ret.move_probabilities = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::MoveWithProbability>>();
-    for (int i = 0; i < probability_output.size(); i++) {
-        SurakartaMove move(
-            i / (BOARD_SIZE * BOARD_SIZE) / BOARD_SIZE,
-            i / (BOARD_SIZE * BOARD_SIZE) % BOARD_SIZE,
-            i % (BOARD_SIZE * BOARD_SIZE) / BOARD_SIZE,
-            i % (BOARD_SIZE * BOARD_SIZE) % BOARD_SIZE,
-            SurakartaPlayer::UNKNOWN);
-        SurakartaAlphazeroNeuralNetworkBase::MoveWithProbability move_with_probability;
-        move_with_probability.move = move;
-        move_with_probability.probability = probability_output[i];
-        ret.move_probabilities->push_back(move_with_probability);
-    }
-    ret.current_status_value = value_output[0];
-    return ret;
+/// @brief tiny-dnn's Adam, except that fit() does not reset it, so that the moments carry over from
+/// one Train() to the next, and that its state can be saved with the model.
+class PersistentAdam : public tiny_dnn::adam {
+   public:
+    void reset() override {}
+
+    /// @brief Write the moments of every weight of network, in layer order.
+    void Save(const std::string& path, tiny_dnn::network<tiny_dnn::graph>& network, int64_t step) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(kMagic, sizeof(kMagic));
+        WriteValue(file, kVersion);
+        WriteValue(file, step);
+        WriteValue(file, b1_t);
+        WriteValue(file, b2_t);
+        const auto weights = AllWeights(network);
+        WriteValue(file, static_cast<uint64_t>(weights.size()));
+        for (const auto* weight : weights) {
+            WriteValue(file, static_cast<uint64_t>(weight->size()));
+            for (auto& moments : E_) {
+                const auto found = moments.find(weight);
+                const tiny_dnn::vec_t zeros(found == moments.end() ? weight->size() : 0);
+                const auto& moment = found == moments.end() ? zeros : found->second;
+                file.write(reinterpret_cast<const char*>(moment.data()), moment.size() * sizeof(tiny_dnn::float_t));
+            }
+        }
+        if (!file) {
+            throw std::runtime_error("Cannot write optimizer state " + path);
+        }
+    }
+
+    /// @brief Read the state written by Save() for the same network.
+    /// @return The step count, 0 if there is no state.
+    /// @throw std::runtime_error if the state is malformed or belongs to another network.
+    int64_t Load(const std::string& path, tiny_dnn::network<tiny_dnn::graph>& network) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return 0;
+        }
+        char magic[sizeof(kMagic)];
+        file.read(magic, sizeof(magic));
+        uint32_t version = 0;
+        ReadValue(file, version);
+        if (!file || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || version != kVersion) {
+            throw std::runtime_error(path + " is not an optimizer state");
+        }
+        int64_t step;
+        uint64_t count;
+        ReadValue(file, step);
+        ReadValue(file, b1_t);
+        ReadValue(file, b2_t);
+        ReadValue(file, count);
+        const auto weights = AllWeights(network);
+        if (!file || count != weights.size()) {
+            throw std::runtime_error(path + " does not match the model");
+        }
+        for (const auto* weight : weights) {
+            uint64_t size;
+            ReadValue(file, size);
+            if (!file || size != weight->size()) {
+                throw std::runtime_error(path + " does not match the model");
+            }
+            for (auto& moments : E_) {
+                auto& moment = moments[weight];
+                moment.resize(size);
+                file.read(reinterpret_cast<char*>(moment.data()), size * sizeof(tiny_dnn::float_t));
+            }
+        }
+        if (!file) {
+            throw std::runtime_error("Truncated optimizer state " + path);
+        }
+        return step;
+    }
+
+   private:
+    static constexpr char kMagic[8] = {'S', 'K', 'A', 'D', 'A', 'M', '\0', '\0'};
+    static constexpr uint32_t kVersion = 1;
+
+    template <typename T>
+    static void WriteValue(std::ofstream& file, const T& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void ReadValue(std::ifstream& file, T& value) {
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+};
+
+/// @brief Keeps the gradients tiny-dnn hands to the optimizer instead of applying them, so that
+/// the shards of a batch can run on the network and its replicas and be reduced into one update.
+class GradientRecorder : public tiny_dnn::optimizer {
+   public:
+    void update(const tiny_dnn::vec_t& dW, tiny_dnn::vec_t& W, bool) override { gradients_[&W] = dW; }
+
+    /// @brief The gradient of the last batch, which tiny-dnn averages over its samples.
+    const tiny_dnn::vec_t& Gradient(const tiny_dnn::vec_t* weight) const { return gradients_.at(weight); }
+
+   private:
+    std::unordered_map<const tiny_dnn::vec_t*, tiny_dnn::vec_t> gradients_;
+};
+
+float SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions::LearningRate(long long step) const {
+    constexpr double kPi = 3.14159265358979323846;
+    const long long steps = std::max(schedule_steps, 1LL);
+    switch (schedule) {
+        case Schedule::STEP:
+            return learning_rate * std::pow(decay, static_cast<float>(step / steps));
+        case Schedule::COSINE: {
+            const double progress = static_cast<double>(std::min(step, steps)) / steps;
+            return static_cast<float>(learning_rate * (decay + (1 - decay) * 0.5 * (1 + std::cos(kPi * progress))));
+        }
+        case Schedule::CONSTANT:
+        default:
+            return learning_rate;
+    }
 }
 
-/// @return first: probability_output, second: value_output
-static tiny_dnn::tensor_t ConvertOutput(
-    SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput& output) {
-    tiny_dnn::vec_t probability_output(output_vector_size_probabilities);
-    tiny_dnn::vec_t value_output(1);
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            for (int k = 0; k < BOARD_SIZE; k++) {
-                for (int l = 0; l < BOARD_SIZE; l++) {
-                    const int index = i * BOARD_SIZE * BOARD_SIZE * BOARD_SIZE + j * BOARD_SIZE * BOARD_SIZE + k * BOARD_SIZE + l;
-                    int found_index = -1;
-                    for (int m = 0; m < output.move_probabilities->size(); m++) {
-                        const auto move = output.move_probabilities->at(m).move;
-                        if (move.from.x == i &&
-                            move.from.y == j &&
-                            move.to.x == k &&
-                            move.to.y == l) {
-                            found_index = m;
-                            break;
-                        }
-                    }
-                    if (found_index == -1) {
-                        probability_output[index] = 0.0f;
-                    } else {
-                        probability_output[index] = output.move_probabilities->at(found_index).probability;
-                    }
+/// @brief Run body(i) for every i in [0, count), split over at most max_threads threads.
+template <typename Function>
+static void ParallelFor(size_t count, Function body, size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u)) {
+    const size_t thread_count = std::min(max_threads, count);
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < count; i += thread_count) {
+                body(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/// @brief Threads that run ParallelFor()-style loops for as long as the pool lives, so that the
+/// loops of every training step do not start threads of their own.
+class WorkerPool {
+   public:
+    /// @param thread_count Threads running each loop, the one calling Run() included.
+    explicit WorkerPool(size_t thread_count) : thread_count_(std::max<size_t>(thread_count, 1)) {
+        for (size_t t = 1; t < thread_count_; t++) {
+            threads_.emplace_back([this, t]() { Work(t); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// @brief Run body(i) for every i in [0, count). Thread t runs the i with i % thread_count == t.
+    void Run(size_t count, const std::function<void(size_t)>& body) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            body_ = &body;
+            count_ = count;
+            running_ = threads_.size();
+            generation_++;
+        }
+        work_ready_.notify_all();
+        RunShare(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_done_.wait(lock, [this]() { return running_ == 0; });
+    }
+
+   private:
+    void Work(size_t t) {
+        uint64_t generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_ready_.wait(lock, [&]() { return stopping_ || generation_ != generation; });
+                if (stopping_) {
+                    return;
                 }
+                generation = generation_;
+            }
+            RunShare(t);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--running_ == 0) {
+                work_done_.notify_one();
             }
         }
     }
-    value_output[0] = output.current_status_value;
-    return {probability_output, value_output};
+
+    void RunShare(size_t t) {
+        for (size_t i = t; i < count_; i += thread_count_) {
+            (*body_)(i);
+        }
+    }
+
+    const size_t thread_count_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    const std::function<void(size_t)>* body_ = nullptr;  // Set with count_ by Run(), under mutex_
+    size_t count_ = 0;
+    size_t running_ = 0;  // Threads of threads_ still running the current loop
+    uint64_t generation_ = 0;  // Counts the loops, so that a woken thread knows whether there is a new one
+    bool stopping_ = false;
+};
+
+/// @brief Copy the weights of a network built by CreateModelToFile() with a dense trunk, one row per output.
+/// @throw std::runtime_error if the network has another architecture.
+static void ReadDenseLayers(tiny_dnn::network<tiny_dnn::graph>& network,
+                            const SurakartaAlphazeroNeuralNetworkArchitecture& architecture,
+                            std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer>& trunk,
+                            SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& policy_head,
+                            SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& value_head) {
+    trunk.clear();
+    policy_head = SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer();
+    value_head = SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer();
+    for (size_t i = 0; i < network.depth(); i++) {
+        auto& layer = *network[i];
+        if (layer.layer_type() != "fully-connected") {
+            continue;
+        }
+        SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer dense;
+        dense.input_size = layer.in_data_size();
+        dense.output_size = layer.out_data_size();
+        // tiny-dnn keeps W[i * output_size + o]; the snapshot wants a row per output
+        const auto& weights = *layer.weights()[0];
+        dense.weights.resize(weights.size());
+        for (int in = 0; in < dense.input_size; in++) {
+            for (int out = 0; out < dense.output_size; out++) {
+                dense.weights[out * dense.input_size + in] = weights[in * dense.output_size + out];
+            }
+        }
+        const auto& biases = *layer.weights()[1];
+        dense.biases.assign(biases.begin(), biases.end());
+        if (dense.output_size == architecture.PolicySize()) {
+            dense.activation = architecture.policy_output == SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput::SOFTMAX
+                                   ? SurakartaAlphazeroNeuralNetworkSnapshot::Activation::IDENTITY
+                                   : SurakartaAlphazeroNeuralNetworkSnapshot::Activation::SIGMOID;
+            policy_head = std::move(dense);
+        } else if (dense.output_size == 1) {
+            dense.activation = SurakartaAlphazeroNeuralNetworkSnapshot::Activation::TANH;
+            value_head = std::move(dense);
+        } else {
+            dense.activation = SurakartaAlphazeroNeuralNetworkSnapshot::Activation::TANH;
+            trunk.push_back(std::move(dense));
+        }
+    }
+    bool valid = !trunk.empty() && trunk.front().input_size == architecture.InputSize() &&
+                 policy_head.input_size == trunk.back().output_size &&
+                 value_head.input_size == trunk.back().output_size;
+    for (size_t i = 1; i < trunk.size(); i++) {
+        valid = valid && trunk[i].input_size == trunk[i - 1].output_size;
+    }
+    if (!valid) {
+        throw std::runtime_error("Unsupported network architecture");
+    }
+}
+
+static std::shared_ptr<const SurakartaAlphazeroNeuralNetworkSnapshot> TakeSnapshot(
+    tiny_dnn::network<tiny_dnn::graph>& network,
+    const SurakartaAlphazeroNeuralNetworkArchitecture& architecture,
+    uint64_t version,
+    SurakartaAlphazeroNeuralNetworkSnapshot::Kernel kernel) {
+    std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer> trunk;
+    SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer policy_head;
+    SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer value_head;
+    ReadDenseLayers(network, architecture, trunk, policy_head, value_head);
+    return std::make_shared<SurakartaAlphazeroNeuralNetworkSnapshot>(version, trunk, policy_head, value_head, kernel);
 }
 
 class SurakartaAlphazeroNeuralNetworkImpl : public SurakartaAlphazeroNeuralNetworkBase {
    public:
+    // With a snapshot backend, predictions only read the current snapshot and never take the mutex
     virtual NeuralNetworkOutput Predict(NeuralNetworkInput input) override {
-        std::lock_guard<std::mutex> lock(mutex);
-        const auto input_tensor = ConvertInput(input);
-        const auto output_tensor = network_->predict(input_tensor);
-        return ConvertOutput(output_tensor);
+        if (!use_snapshot_) {
+            return PredictTinyDnn(input);
+        }
+        const auto snapshot = LocalSnapshot();
+        std::vector<float> features(architecture_.InputSize());
+        architecture_.EncodeInput(input, features.data());
+        const auto policy_indexes = PolicyIndexes(input);
+        std::vector<float> policy(policy_indexes.size());
+        float value;
+        snapshot->Forward(features.data(), policy_indexes.data(), policy_indexes.size(), policy.data(), &value);
+        return MakeOutput(input, Priors(input, policy), value);
+    }
+
+    virtual std::vector<NeuralNetworkOutput> PredictBatch(std::vector<NeuralNetworkInput> inputs) override {
+        if (!use_snapshot_) {
+            return PredictTinyDnnBatch(inputs);
+        }
+        const auto snapshot = LocalSnapshot();
+        const size_t input_size = architecture_.InputSize();
+        std::vector<float> features(inputs.size() * input_size);
+        std::vector<std::vector<int>> policy_indexes(inputs.size());
+        for (size_t b = 0; b < inputs.size(); b++) {
+            architecture_.EncodeInput(inputs[b], features.data() + b * input_size);
+            policy_indexes[b] = PolicyIndexes(inputs[b]);
+        }
+        std::vector<std::vector<float>> policies(inputs.size());
+        std::vector<float> values(inputs.size());
+        snapshot->ForwardBatch(inputs.size(), features.data(), policy_indexes.data(), policies.data(), values.data());
+        std::vector<NeuralNetworkOutput> outputs;
+        outputs.reserve(inputs.size());
+        for (size_t b = 0; b < inputs.size(); b++) {
+            outputs.push_back(MakeOutput(inputs[b], Priors(inputs[b], policies[b]), values[b]));
+        }
+        return outputs;
     }
 
     virtual void Train(std::unique_ptr<std::vector<TrainEntry>> train_data) override {
-        std::lock_guard<std::mutex> lock(mutex);
+        auto& metrics = SurakartaAlphazeroMetrics::Global();
+        SurakartaAlphazeroMetrics::ScopedTimer timer(SurakartaAlphazeroMetrics::Counter::TRAIN_MICROSECONDS);
+        // Encoding does not touch the network, so it runs before the lock is taken
         std::vector<tiny_dnn::tensor_t> input_tensor(train_data->size());
         std::vector<tiny_dnn::tensor_t> output_tensor(train_data->size());
-        for (int i = 0; i < train_data->size(); i++) {
-            input_tensor[i] = ConvertInput(*train_data->at(i).input);
-            output_tensor[i] = ConvertOutput(*train_data->at(i).output);
+        ParallelFor(train_data->size(), [&](size_t i) {
+            input_tensor[i] = ConvertInput(architecture_, *train_data->at(i).input);
+            output_tensor[i] = ConvertOutput(architecture_, *train_data->at(i).output);
+        });
+        const auto lock = LockNetwork();
+        if (architecture_.policy_output == SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput::SOFTMAX) {
+            Fit<SoftmaxCrossEntropyMse>(input_tensor, output_tensor);
+            if (metrics.Enabled()) {
+                MeasureLoss<SoftmaxCrossEntropyMse>(input_tensor, output_tensor);
+            }
+        } else {
+            Fit<tiny_dnn::mse>(input_tensor, output_tensor);
+            if (metrics.Enabled()) {
+                MeasureLoss<tiny_dnn::mse>(input_tensor, output_tensor);
+            }
+        }
+        if (metrics.Enabled()) {
+            metrics.Add(SurakartaAlphazeroMetrics::Counter::TRAIN_SAMPLES, input_tensor.size() * epochs);
+        }
+        if (use_snapshot_) {
+            std::atomic_store(&snapshot_, TakeSnapshot(*network_, architecture_, snapshot_->Version() + 1, snapshot_->GetKernel()));
         }
-        tiny_dnn::adam optimizer;
-        network_->fit<tiny_dnn::mse>(optimizer, input_tensor, output_tensor, train_batch_size, epochs);
     }
 
     virtual void SaveModel(const std::string& model_path) override {
-        std::lock_guard<std::mutex> lock(mutex);
+        const auto lock = LockNetwork();
         network_->save(model_path);
+        architecture_.Save(model_path);
+        optimizer_.Save(SurakartaAlphazeroNeuralNetworkFactory::OptimizerStatePath(model_path), *network_, step_);
     }
 
    private:
     friend class SurakartaAlphazeroNeuralNetworkFactory;
     std::unique_ptr<tiny_dnn::network<tiny_dnn::graph>> network_;
+    std::shared_ptr<const SurakartaAlphazeroNeuralNetworkSnapshot> snapshot_;  // Only accessed through std::atomic_load/std::atomic_store; nullptr when predicting with tiny-dnn
+    struct NodeSnapshot {
+        std::mutex mutex;  // Taken to replace the copy
+        std::shared_ptr<const SurakartaAlphazeroNeuralNetworkSnapshot> snapshot;  // Accessed like snapshot_
+    };
+    std::unique_ptr<NodeSnapshot[]> node_snapshots_;  // One per NUMA node, see LocalSnapshot(); nullptr on a single node
+    int node_count_ = 0;
+    const SurakartaAlphazeroNeuralNetworkArchitecture architecture_;
+    bool use_snapshot_ = false;
+    const SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions training_options_;
+    PersistentAdam optimizer_;
+    int64_t step_ = 0;  // Optimizer steps taken, drives the learning rate schedule
+    std::vector<std::unique_ptr<tiny_dnn::network<tiny_dnn::graph>>> replicas_;  // Data-parallel workers but the first, see FitDataParallel()
+    std::vector<std::vector<tiny_dnn::vec_t*>> replica_weights_;
     const size_t train_batch_size;
     const size_t epochs;
-    std::mutex mutex;
+    std::mutex mutex;  // Guards network_, optimizer_, step_ and the replicas
+
+    SurakartaAlphazeroNeuralNetworkImpl(size_t train_batch_size,
+                                        size_t epochs,
+                                        SurakartaAlphazeroNeuralNetworkFactory::Backend backend,
+                                        const SurakartaAlphazeroNeuralNetworkArchitecture& architecture,
+                                        const SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions& training_options,
+                                        std::unique_ptr<tiny_dnn::network<tiny_dnn::graph>> network_)
+        : network_(std::move(network_)),
+          architecture_(architecture),
+          training_options_(training_options),
+          train_batch_size(train_batch_size),
+          epochs(epochs) {
+        // The snapshot kernels only implement dense layers, so convolutional trunks always predict with tiny-dnn,
+        // and batch through PredictTinyDnnBatch()
+        if (architecture.trunk != SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::DENSE) {
+            return;
+        }
+        if (backend == SurakartaAlphazeroNeuralNetworkFactory::Backend::SCALAR) {
+            snapshot_ = TakeSnapshot(*this->network_, architecture_, 0, SurakartaAlphazeroNeuralNetworkSnapshot::Kernel::SCALAR);
+        } else if (backend == SurakartaAlphazeroNeuralNetworkFactory::Backend::SIMD) {
+            snapshot_ = TakeSnapshot(*this->network_, architecture_, 0, SurakartaAlphazeroNeuralNetworkSnapshot::BestKernel());
+        }
+        use_snapshot_ = snapshot_ != nullptr;
+        const int node_count = SurakartaAlphazeroThreadPlacement::Topology().size();
+        if (use_snapshot_ && node_count > 1) {
+            node_snapshots_ = std::make_unique<NodeSnapshot[]>(node_count);
+            node_count_ = node_count;
+        }
+    }
+
+    /// @brief The snapshot to predict with. A thread pinned to a NUMA node reads a copy of the
+    /// current snapshot made by the first thread of the node that needed it, so that its weights
+    /// live on the node, see SurakartaAlphazeroThreadPlacement.
+    std::shared_ptr<const SurakartaAlphazeroNeuralNetworkSnapshot> LocalSnapshot() {
+        const auto snapshot = std::atomic_load(&snapshot_);
+        const int node = SurakartaAlphazeroThreadPlacement::CurrentNode();
+        if (node < 0 || node >= node_count_) {
+            return snapshot;
+        }
+        auto& local = node_snapshots_[node];
+        auto copy = std::atomic_load(&local.snapshot);
+        // A copy can be newer than the snapshot loaded above, when training published one meanwhile
+        if (copy == nullptr || copy->Version() < snapshot->Version()) {
+            std::lock_guard<std::mutex> lock(local.mutex);
+            copy = std::atomic_load(&local.snapshot);
+            if (copy == nullptr || copy->Version() < snapshot->Version()) {
+                copy = std::make_shared<const SurakartaAlphazeroNeuralNetworkSnapshot>(*snapshot);
+                std::atomic_store(&local.snapshot, copy);
+            }
+        }
+        return copy;
+    }
+
+    /// @brief Take mutex, timing the wait for SurakartaAlphazeroMetrics.
+    std::unique_lock<std::mutex> LockNetwork() {
+        SurakartaAlphazeroMetrics::ScopedTimer timer(SurakartaAlphazeroMetrics::Histogram::MODEL_LOCK_WAIT_US);
+        return std::unique_lock<std::mutex>(mutex);
+    }
+
+    /// @brief Set the loss gauges of SurakartaAlphazeroMetrics to the mean loss of each head over
+    /// evenly spaced entries of the data, with mutex held.
+    template <typename Loss>
+    void MeasureLoss(const std::vector<tiny_dnn::tensor_t>& input_tensor, const std::vector<tiny_dnn::tensor_t>& output_tensor) {
+        constexpr size_t kMaxSamples = 256;
+        const size_t stride = std::max<size_t>(input_tensor.size() / kMaxSamples, 1);
+        double policy_loss = 0;
+        double value_loss = 0;
+        size_t samples = 0;
+        for (size_t i = 0; i < input_tensor.size(); i += stride) {
+            const auto output = network_->predict(input_tensor[i]);
+            policy_loss += Loss::f(output[0], output_tensor[i][0]);
+            value_loss += tiny_dnn::mse::f(output[1], output_tensor[i][1]);
+            samples++;
+        }
+        if (samples > 0) {
+            auto& metrics = SurakartaAlphazeroMetrics::Global();
+            metrics.Set(SurakartaAlphazeroMetrics::Gauge::POLICY_LOSS, policy_loss / samples);
+            metrics.Set(SurakartaAlphazeroMetrics::Gauge::VALUE_LOSS, value_loss / samples);
+        }
+    }
+
+    /// @brief Run the optimizer over the data, stepping the learning rate schedule and decaying the weights after every batch.
+    template <typename Loss>
+    void Fit(const std::vector<tiny_dnn::tensor_t>& input_tensor, const std::vector<tiny_dnn::tensor_t>& output_tensor) {
+        optimizer_.alpha = training_options_.LearningRate(step_);
+        const size_t workers = std::min<size_t>(std::max(training_options_.threads, 1), train_batch_size);
+        if (workers > 1) {
+            FitDataParallel<Loss>(input_tensor, output_tensor, workers);
+            return;
+        }
+        network_->fit<Loss>(
+            optimizer_, input_tensor, output_tensor, train_batch_size, epochs,
+            [&]() { FinishStep(); },
+            []() {});
+    }
+
+    /// @brief Fit() with every batch split into shards, one per worker. Each worker computes the
+    /// gradient of its shard, the first one on network_ itself and the others on replicas of it; the
+    /// gradients are reduced into the gradient of the whole batch, and one update is applied to
+    /// network_, as a single-threaded fit would. The workers are started once for the whole fit.
+    template <typename Loss>
+    void FitDataParallel(const std::vector<tiny_dnn::tensor_t>& input_tensor,
+                         const std::vector<tiny_dnn::tensor_t>& output_tensor,
+                         size_t workers) {
+        constexpr size_t kChunkSize = 1 << 14;
+        PrepareReplicas(workers - 1);
+        const auto weights = AllWeights(*network_);
+        const auto shard_weights = [&](size_t k) -> const std::vector<tiny_dnn::vec_t*>& {
+            return k == 0 ? weights : replica_weights_[k - 1];
+        };
+        std::vector<tiny_dnn::vec_t> gradients(weights.size());
+        std::vector<std::pair<size_t, size_t>> chunks;  // (weight, first element) of each slice of the sync and the reduction
+        for (size_t w = 0; w < weights.size(); w++) {
+            gradients[w].resize(weights[w]->size());
+            for (size_t begin = 0; begin < weights[w]->size(); begin += kChunkSize) {
+                chunks.emplace_back(w, begin);
+            }
+        }
+        std::vector<GradientRecorder> recorders(workers);
+        WorkerPool pool(workers);
+        for (size_t epoch = 0; epoch < epochs; epoch++) {
+            for (size_t batch_begin = 0; batch_begin < input_tensor.size(); batch_begin += train_batch_size) {
+                const size_t batch_size = std::min(train_batch_size, input_tensor.size() - batch_begin);
+                const size_t shard_count = std::min(workers, batch_size);
+                const auto shard_begin = [&](size_t k) { return batch_begin + batch_size * k / shard_count; };
+                // tiny-dnn layers own their weights, so the replicas cannot read those of network_ in place.
+                // network_ stays read-only until the update, so they are synced from it once per step,
+                // each worker copying a share of the slices into every replica in use.
+                pool.Run(shard_count > 1 ? chunks.size() : 0, [&](size_t c) {
+                    const size_t w = chunks[c].first;
+                    const auto begin = weights[w]->begin() + chunks[c].second;
+                    const auto end = weights[w]->begin() + std::min(chunks[c].second + kChunkSize, weights[w]->size());
+                    for (size_t k = 1; k < shard_count; k++) {
+                        std::copy(begin, end, shard_weights(k)[w]->begin() + chunks[c].second);
+                    }
+                });
+                pool.Run(shard_count, [&](size_t k) {
+                    auto& network = k == 0 ? *network_ : *replicas_[k - 1];
+                    const std::vector<tiny_dnn::tensor_t> shard_input(input_tensor.begin() + shard_begin(k), input_tensor.begin() + shard_begin(k + 1));
+                    const std::vector<tiny_dnn::tensor_t> shard_output(output_tensor.begin() + shard_begin(k), output_tensor.begin() + shard_begin(k + 1));
+                    network.template fit<Loss>(recorders[k], shard_input, shard_output, shard_input.size(), 1);
+                });
+                // The gradients are means over their shards, so the batch mean weighs them by shard size
+                pool.Run(chunks.size(), [&](size_t c) {
+                    const size_t w = chunks[c].first;
+                    const size_t begin = chunks[c].second;
+                    const size_t end = std::min(begin + kChunkSize, gradients[w].size());
+                    std::fill(gradients[w].begin() + begin, gradients[w].begin() + end, 0.0f);
+                    for (size_t k = 0; k < shard_count; k++) {
+                        const auto& shard_gradient = recorders[k].Gradient(shard_weights(k)[w]);
+                        const float share = static_cast<float>(shard_begin(k + 1) - shard_begin(k)) / batch_size;
+                        for (size_t i = begin; i < end; i++) {
+                            gradients[w][i] += share * shard_gradient[i];
+                        }
+                    }
+                });
+                for (size_t w = 0; w < weights.size(); w++) {
+                    optimizer_.update(gradients[w], *weights[w], true);
+                }
+                FinishStep();
+            }
+        }
+    }
+
+    /// @brief Make sure there are at least count replicas of network_. Their weights are
+    /// synced from network_ at the start of every step that uses them.
+    void PrepareReplicas(size_t count) {
+        if (replicas_.size() >= count) {
+            return;
+        }
+        const auto model = network_->to_json(tiny_dnn::content_type::model);
+        while (replicas_.size() < count) {
+            auto replica = std::make_unique<tiny_dnn::network<tiny_dnn::graph>>();
+            replica->from_json(model, tiny_dnn::content_type::model);
+            replica->init_weight();
+            replica_weights_.push_back(AllWeights(*replica));
+            replicas_.push_back(std::move(replica));
+        }
+    }
+
+    /// @brief Bookkeeping after each optimizer step.
+    void FinishStep() {
+        if (training_options_.l2 > 0) {
+            DecayWeights(1 - optimizer_.alpha * training_options_.l2);
+        }
+        step_++;
+        optimizer_.alpha = training_options_.LearningRate(step_);
+    }
+
+    void DecayWeights(float factor) {
+        for (size_t i = 0; i < network_->depth(); i++) {
+            auto& layer = *(*network_)[i];
+            if (layer.layer_type() != "fully-connected" && layer.layer_type() != "conv") {
+                continue;
+            }
+            for (auto& weight : *layer.weights()[0]) {
+                weight *= factor;
+            }
+        }
+    }
+
+    /// @brief The policy outputs a snapshot prediction needs: one per legal move with a dense head,
+    /// the whole head with a factorized one.
+    std::vector<int> PolicyIndexes(const NeuralNetworkInput& input) const {
+        std::vector<int> policy_indexes;
+        if (architecture_.policy_head == SurakartaAlphazeroNeuralNetworkArchitecture::PolicyHead::DENSE) {
+            policy_indexes.resize(input.legal_moves.size());
+            for (size_t i = 0; i < input.legal_moves.size(); i++) {
+                policy_indexes[i] = MoveToIndex(input.legal_moves[i]);
+            }
+        } else {
+            policy_indexes.resize(architecture_.PolicySize());
+            for (int i = 0; i < architecture_.PolicySize(); i++) {
+                policy_indexes[i] = i;
+            }
+        }
+        return policy_indexes;
+    }
+
+    /// @brief The priors of the legal moves, given the outputs requested by PolicyIndexes().
+    std::vector<float> Priors(const NeuralNetworkInput& input, std::vector<float>& policy) const {
+        if (architecture_.policy_head == SurakartaAlphazeroNeuralNetworkArchitecture::PolicyHead::DENSE) {
+            return architecture_.DenseMovePriors(std::move(policy));
+        }
+        return architecture_.MovePriors(policy.data(), input.legal_moves);
+    }
+
+    static NeuralNetworkOutput MakeOutput(const NeuralNetworkInput& input, const std::vector<float>& policy, float value) {
+        NeuralNetworkOutput output;
+        output.move_probabilities = std::make_unique<std::vector<MoveWithProbability>>(input.legal_moves.size());
+        for (size_t i = 0; i < input.legal_moves.size(); i++) {
+            (*output.move_probabilities)[i].move = input.legal_moves[i];
+            (*output.move_probabilities)[i].probability = policy[i];
+        }
+        output.current_status_value = value;
+        return output;
+    }
+
+    // tiny-dnn keeps the activations of the last forward pass in its layers, so it runs under the mutex
+    NeuralNetworkOutput PredictTinyDnn(NeuralNetworkInput& input) {
+        auto input_tensor = ConvertInput(architecture_, input);
+        tiny_dnn::tensor_t output_tensor;
+        {
+            const auto lock = LockNetwork();
+            output_tensor = network_->predict(input_tensor);
+        }
+        return MakeOutput(input, architecture_.MovePriors(output_tensor[0].data(), input.legal_moves), output_tensor[1][0]);
+    }
 
-    SurakartaAlphazeroNeuralNetworkImpl(size_t train_batch_size, size_t epochs, std::unique_ptr<tiny_dnn::network<tiny_dnn::graph>> network_)
-        : train_batch_size(train_batch_size), epochs(epochs), network_(std::move(network_)) {}
+    // One forward pass over the whole batch, under the mutex like PredictTinyDnn()
+    std::vector<NeuralNetworkOutput> PredictTinyDnnBatch(std::vector<NeuralNetworkInput>& inputs) {
+        std::vector<tiny_dnn::tensor_t> input_tensors(inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            input_tensors[i] = ConvertInput(architecture_, inputs[i]);
+        }
+        std::vector<tiny_dnn::tensor_t> output_tensors;
+        {
+            const auto lock = LockNetwork();
+            output_tensors = network_->predict(input_tensors);
+        }
+        std::vector<NeuralNetworkOutput> outputs;
+        outputs.reserve(inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            outputs.push_back(MakeOutput(inputs[i], architecture_.MovePriors(output_tensors[i][0].data(), inputs[i].legal_moves),
+                                         output_tensors[i][1][0]));
+        }
+        return outputs;
+    }
 };
 
-static void CreateModelToFile(const std::string& model_path) {
-    tiny_dnn::input_layer in(input_vector_size);
-    tiny_dnn::fully_connected_layer hidden_1(input_vector_size, hidden_layer_size);
-    tiny_dnn::tanh_layer hidden_1_activation(hidden_layer_size);
-    tiny_dnn::fully_connected_layer hidden_2(hidden_layer_size, hidden_layer_size);
-    tiny_dnn::tanh_layer hidden_2_activation(hidden_layer_size);
-    tiny_dnn::fully_connected_layer hidden_3(hidden_layer_size, hidden_layer_size);
-    tiny_dnn::tanh_layer hidden_3_activation(hidden_layer_size);
-    tiny_dnn::fully_connected_layer hidden_4(hidden_layer_size, hidden_layer_size);
-    tiny_dnn::tanh_layer hidden_4_activation(hidden_layer_size);
-    tiny_dnn::fully_connected_layer hidden_5(hidden_layer_size, hidden_layer_size);
-    tiny_dnn::tanh_layer hidden_5_activation(hidden_layer_size);
-    tiny_dnn::fully_connected_layer out_1(hidden_layer_size, output_vector_size_probabilities);
-    tiny_dnn::sigmoid_layer out_1_activation(output_vector_size_probabilities);
-    tiny_dnn::fully_connected_layer out_2(hidden_layer_size, output_vector_size_value);
-    tiny_dnn::tanh_layer out_2_activation(output_vector_size_value);
-    auto& tmp = in << hidden_1 << hidden_1_activation
-                   << hidden_2 << hidden_2_activation
-                   << hidden_3 << hidden_3_activation
-                   << hidden_4 << hidden_4_activation
-                   << hidden_5 << hidden_5_activation;
-    tmp << out_1 << out_1_activation;
-    tmp << out_2 << out_2_activation;
+static void CreateModelToFile(const std::string& model_path, const SurakartaAlphazeroNeuralNetworkArchitecture& architecture) {
+    constexpr size_t kCellCount = BOARD_SIZE * BOARD_SIZE;
+    const size_t width = architecture.width;
+    // tiny-dnn graphs refer to their layers by pointer, so they live here until the network is saved
+    std::vector<std::unique_ptr<tiny_dnn::layer>> layers;
+    auto add = [&layers](tiny_dnn::layer* layer) {
+        layers.emplace_back(layer);
+        return layer;
+    };
+    auto chain = [&add](tiny_dnn::layer* from, tiny_dnn::layer* to) {
+        tiny_dnn::connect(from, add(to));
+        return to;
+    };
+
+    tiny_dnn::layer* in;
+    tiny_dnn::layer* trunk;
+    size_t trunk_size;
+    if (architecture.trunk == SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::DENSE) {
+        in = add(new tiny_dnn::input_layer(architecture.InputSize()));
+        trunk = in;
+        trunk_size = architecture.InputSize();
+        for (int i = 0; i < architecture.depth; i++) {
+            trunk = chain(trunk, new tiny_dnn::fully_connected_layer(trunk_size, width));
+            trunk = chain(trunk, new tiny_dnn::tanh_layer(width));
+            trunk_size = width;
+        }
+    } else {
+        auto convolution = [&](size_t in_channels) {
+            return new tiny_dnn::convolutional_layer(BOARD_SIZE, BOARD_SIZE, 3, in_channels, width, tiny_dnn::padding::same);
+        };
+        in = add(new tiny_dnn::input_layer(tiny_dnn::shape3d(BOARD_SIZE, BOARD_SIZE, SurakartaAlphazeroNeuralNetworkArchitecture::kPlaneCount)));
+        trunk = chain(in, convolution(SurakartaAlphazeroNeuralNetworkArchitecture::kPlaneCount));
+        trunk = chain(trunk, new tiny_dnn::relu_layer(BOARD_SIZE, BOARD_SIZE, width));
+        for (int i = 0; i < architecture.depth; i++) {
+            auto block = chain(trunk, convolution(width));
+            block = chain(block, new tiny_dnn::relu_layer(BOARD_SIZE, BOARD_SIZE, width));
+            block = chain(block, convolution(width));
+            auto sum = add(new tiny_dnn::elementwise_add_layer(2, kCellCount * width));
+            tiny_dnn::connect(block, sum, 0, 0);
+            tiny_dnn::connect(trunk, sum, 0, 1);
+            trunk = chain(sum, new tiny_dnn::relu_layer(BOARD_SIZE, BOARD_SIZE, width));
+        }
+        trunk_size = kCellCount * width;
+    }
+    auto policy = chain(trunk, new tiny_dnn::fully_connected_layer(trunk_size, architecture.PolicySize()));
+    if (architecture.policy_output == SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput::SIGMOID) {
+        policy = chain(policy, new tiny_dnn::sigmoid_layer(architecture.PolicySize()));
+    }
+    auto value = chain(trunk, new tiny_dnn::fully_connected_layer(trunk_size, 1));
+    value = chain(value, new tiny_dnn::tanh_layer(1));
     tiny_dnn::network<tiny_dnn::graph> network;
-    tiny_dnn::construct_graph(network, {&in}, {&out_1_activation, &out_2_activation});
+    tiny_dnn::construct_graph(network, {in}, {policy, value});
     network.save(model_path);
+    architecture.Save(model_path);
 }
 
 std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> SurakartaAlphazeroNeuralNetworkFactory::CreateModel(const std::string& model_path) {
-    CreateModelToFile(model_path);
+    if (!architecture_.IsValid()) {
+        throw std::invalid_argument("Invalid network architecture " + architecture_.ToString());
+    }
+    CreateModelToFile(model_path, architecture_);
+    // A new model starts with a new optimizer
+    std::filesystem::remove(OptimizerStatePath(model_path));
     auto network = std::make_unique<tiny_dnn::network<tiny_dnn::graph>>();
     network->load(model_path);
-    auto impl = new SurakartaAlphazeroNeuralNetworkImpl(train_batch_size_, epochs_, std::move(network));
+    auto impl = new SurakartaAlphazeroNeuralNetworkImpl(train_batch_size_, epochs_, backend_, architecture_, training_options_, std::move(network));
     return std::unique_ptr<SurakartaAlphazeroNeuralNetworkImpl>(impl);
 }
 
 std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> SurakartaAlphazeroNeuralNetworkFactory::LoadModel(const std::string& model_path) {
+    const auto architecture = SurakartaAlphazeroNeuralNetworkArchitecture::Load(model_path);
     auto network = std::make_unique<tiny_dnn::network<tiny_dnn::graph>>();
     network->load(model_path);
-    auto impl = new SurakartaAlphazeroNeuralNetworkImpl(train_batch_size_, epochs_, std::move(network));
-    return std::unique_ptr<SurakartaAlphazeroNeuralNetworkImpl>(impl);
+    auto impl = std::unique_ptr<SurakartaAlphazeroNeuralNetworkImpl>(
+        new SurakartaAlphazeroNeuralNetworkImpl(train_batch_size_, epochs_, backend_, architecture, training_options_, std::move(network)));
+    impl->step_ = impl->optimizer_.Load(OptimizerStatePath(model_path), *impl->network_);
+    return impl;
+}
+
+void SurakartaAlphazeroNeuralNetworkFactory::ExportQuantized(const std::string& model_path,
+                                                             const std::string& quantized_model_path,
+                                                             SurakartaAlphazeroNeuralNetworkQuantized::Precision precision) {
+    const auto architecture = SurakartaAlphazeroNeuralNetworkArchitecture::Load(model_path);
+    if (architecture.trunk != SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::DENSE ||
+        architecture.policy_head != SurakartaAlphazeroNeuralNetworkArchitecture::PolicyHead::DENSE) {
+        throw std::runtime_error("Only dense networks can be quantized, " + model_path + " is " + architecture.ToString());
+    }
+    tiny_dnn::network<tiny_dnn::graph> network;
+    network.load(model_path);
+    std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer> trunk;
+    SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer policy_head;
+    SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer value_head;
+    ReadDenseLayers(network, architecture, trunk, policy_head, value_head);
+    SurakartaAlphazeroNeuralNetworkQuantized::Export(quantized_model_path, precision, trunk, policy_head, value_head);
+}
+
+const char* SurakartaAlphazeroNeuralNetworkFactory::BackendName(Backend backend) {
+    switch (backend) {
+        case Backend::TINY_DNN:
+            return "tiny-dnn";
+        case Backend::SCALAR:
+            return "scalar";
+        case Backend::SIMD:
+        default:
+            return "simd";
+    }
+}
+
+bool SurakartaAlphazeroNeuralNetworkFactory::ParseBackend(const std::string& name, Backend& backend) {
+    for (const auto candidate : {Backend::TINY_DNN, Backend::SCALAR, Backend::SIMD}) {
+        if (name == BackendName(candidate)) {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
 }
@@ -0,0 +1,149 @@
+#include "surakarta_alphazero_neural_network_architecture.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+static int CellIndex(const SurakartaPosition& cell) {
+    return cell.x * BOARD_SIZE + cell.y;
+}
+
+void SurakartaAlphazeroNeuralNetworkArchitecture::EncodeInput(const SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput& input,
+                                                             float* features) const {
+    if (trunk == Trunk::DENSE) {
+        SurakartaAlphazeroNeuralNetworkBase::EncodeInput(input, features);
+        return;
+    }
+    constexpr int kCellCount = BOARD_SIZE * BOARD_SIZE;
+    const auto mine = input.position.Pieces(input.my_color);
+    const auto theirs = input.position.Pieces(ReverseColor(input.my_color));
+    const float no_capture_progress =
+        static_cast<float>(input.position.num_round - input.position.last_captured_round) / MAX_NO_CAPTURE_ROUND;
+    for (int i = 0; i < kCellCount; i++) {
+        features[i] = static_cast<float>((mine >> i) & 1);
+        features[kCellCount + i] = static_cast<float>((theirs >> i) & 1);
+        features[2 * kCellCount + i] = no_capture_progress;
+        features[3 * kCellCount + i] = 1.0f;
+    }
+}
+
+void SurakartaAlphazeroNeuralNetworkArchitecture::EncodePolicyTarget(const SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput& output,
+                                                                    float* policy) const {
+    if (policy_head == PolicyHead::DENSE) {
+        SurakartaAlphazeroNeuralNetworkBase::EncodePolicyTarget(output, policy);
+        return;
+    }
+    std::fill(policy, policy + kFactorizedPolicySize, 0.0f);
+    for (const auto& move_with_probability : *output.move_probabilities) {
+        policy[CellIndex(move_with_probability.move.from)] += move_with_probability.probability;
+        policy[BOARD_SIZE * BOARD_SIZE + CellIndex(move_with_probability.move.to)] += move_with_probability.probability;
+    }
+}
+
+std::vector<float> SurakartaAlphazeroNeuralNetworkArchitecture::MovePriors(const float* policy,
+                                                                           const std::vector<SurakartaMove>& moves) const {
+    std::vector<float> priors(moves.size());
+    if (policy_head == PolicyHead::DENSE) {
+        for (size_t i = 0; i < moves.size(); i++) {
+            priors[i] = policy[SurakartaAlphazeroNeuralNetworkBase::MoveToIndex(moves[i])];
+        }
+        return DenseMovePriors(std::move(priors));
+    }
+    constexpr int kCellCount = BOARD_SIZE * BOARD_SIZE;
+    float cells[kFactorizedPolicySize];
+    std::copy(policy, policy + kFactorizedPolicySize, cells);
+    if (policy_output == PolicyOutput::SOFTMAX) {
+        Softmax(cells, kCellCount);
+        Softmax(cells + kCellCount, kCellCount);
+    }
+    float sum = 0;
+    for (size_t i = 0; i < moves.size(); i++) {
+        priors[i] = cells[CellIndex(moves[i].from)] * cells[kCellCount + CellIndex(moves[i].to)];
+        sum += priors[i];
+    }
+    if (policy_output == PolicyOutput::SOFTMAX && sum > 0) {
+        // As with a dense head, the distribution is over the legal moves only
+        for (auto& prior : priors) {
+            prior /= sum;
+        }
+    }
+    return priors;
+}
+
+std::vector<float> SurakartaAlphazeroNeuralNetworkArchitecture::DenseMovePriors(std::vector<float> move_outputs) const {
+    if (policy_output == PolicyOutput::SOFTMAX) {
+        Softmax(move_outputs.data(), move_outputs.size());
+    }
+    return move_outputs;
+}
+
+void SurakartaAlphazeroNeuralNetworkArchitecture::Softmax(float* values, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    const float max = *std::max_element(values, values + count);
+    float sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        values[i] = std::exp(values[i] - max);
+        sum += values[i];
+    }
+    for (size_t i = 0; i < count; i++) {
+        values[i] /= sum;
+    }
+}
+
+std::string SurakartaAlphazeroNeuralNetworkArchitecture::ToString() const {
+    return std::string(trunk == Trunk::DENSE ? "dense " : "residual ") + std::to_string(width) + "x" +
+           std::to_string(depth) + (policy_head == PolicyHead::DENSE ? " dense" : " factorized") +
+           (policy_output == PolicyOutput::SOFTMAX ? " softmax" : "");
+}
+
+void SurakartaAlphazeroNeuralNetworkArchitecture::Save(const std::string& model_path) const {
+    std::ofstream file(MetadataPath(model_path), std::ios::trunc);
+    file << "trunk=" << (trunk == Trunk::DENSE ? "dense" : "residual") << "\n"
+         << "width=" << width << "\n"
+         << "depth=" << depth << "\n"
+         << "policy_head=" << (policy_head == PolicyHead::DENSE ? "dense" : "factorized") << "\n"
+         << "policy_output=" << (policy_output == PolicyOutput::SIGMOID ? "sigmoid" : "softmax") << "\n";
+    if (!file) {
+        throw std::runtime_error("Cannot write " + MetadataPath(model_path));
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkArchitecture SurakartaAlphazeroNeuralNetworkArchitecture::Load(const std::string& model_path) {
+    auto architecture = Default();
+    std::ifstream file(MetadataPath(model_path));
+    if (!file) {
+        return architecture;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        const auto separator = line.find('=');
+        if (line.empty() || separator == std::string::npos) {
+            continue;
+        }
+        const auto key = line.substr(0, separator);
+        const auto value = line.substr(separator + 1);
+        try {
+            if (key == "trunk" && (value == "dense" || value == "residual")) {
+                architecture.trunk = value == "dense" ? Trunk::DENSE : Trunk::RESIDUAL;
+            } else if (key == "width") {
+                architecture.width = std::stoi(value);
+            } else if (key == "depth") {
+                architecture.depth = std::stoi(value);
+            } else if (key == "policy_head" && (value == "dense" || value == "factorized")) {
+                architecture.policy_head = value == "dense" ? PolicyHead::DENSE : PolicyHead::FACTORIZED;
+            } else if (key == "policy_output" && (value == "sigmoid" || value == "softmax")) {
+                architecture.policy_output = value == "sigmoid" ? PolicyOutput::SIGMOID : PolicyOutput::SOFTMAX;
+            } else {
+                throw std::invalid_argument(key);
+            }
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Malformed line in " + MetadataPath(model_path) + ": " + line);
+        }
+    }
+    if (!architecture.IsValid()) {
+        throw std::runtime_error(MetadataPath(model_path) + " describes an invalid architecture");
+    }
+    return architecture;
+}
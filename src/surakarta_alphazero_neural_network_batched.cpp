@@ -0,0 +1,130 @@
+#include "surakarta_alphazero_neural_network_batched.h"
+#include <algorithm>
+#include "surakarta_alphazero_metrics.h"
+
+SurakartaAlphazeroNeuralNetworkBatched::SurakartaAlphazeroNeuralNetworkBatched(
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+    size_t max_batch_size,
+    std::chrono::microseconds flush_timeout,
+    std::shared_ptr<const SurakartaAlphazeroThreadPlacement> placement)
+    : model_(model),
+      max_batch_size_(std::max<size_t>(max_batch_size, 1)),
+      flush_timeout_(flush_timeout),
+      queue_count_(placement ? placement->NodeCount() : 1) {
+    queues_ = std::make_unique<Queue[]>(queue_count_);
+    for (int i = 0; i < queue_count_; i++) {
+        queues_[i].worker = std::thread([this, placement, i]() {
+            if (placement) {
+                placement->PinToNode(i);
+            }
+            ServeLoop(queues_[i]);
+        });
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkBatched::~SurakartaAlphazeroNeuralNetworkBatched() {
+    for (int i = 0; i < queue_count_; i++) {
+        {
+            std::lock_guard<std::mutex> lock(queues_[i].mutex);
+            queues_[i].stopping = true;
+        }
+        queues_[i].condition.notify_all();
+    }
+    for (int i = 0; i < queue_count_; i++) {
+        queues_[i].worker.join();
+    }
+}
+
+std::future<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput>
+SurakartaAlphazeroNeuralNetworkBatched::Enqueue(NeuralNetworkInput input) {
+    Request request;
+    request.input = std::move(input);
+    request.enqueue_time = std::chrono::steady_clock::now();
+    auto future = request.promise.get_future();
+    const int node = SurakartaAlphazeroThreadPlacement::CurrentNode();
+    auto& queue = queues_[node > 0 && node < queue_count_ ? node : 0];
+    bool should_notify;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pending.push_back(std::move(request));
+        // Wake the worker when a new batch starts or the current one fills up
+        should_notify = queue.pending.size() == 1 || queue.pending.size() >= max_batch_size_;
+    }
+    if (should_notify) {
+        queue.condition.notify_all();
+    }
+    return future;
+}
+
+SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput
+SurakartaAlphazeroNeuralNetworkBatched::Predict(NeuralNetworkInput input) {
+    return Enqueue(std::move(input)).get();
+}
+
+std::vector<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput>
+SurakartaAlphazeroNeuralNetworkBatched::PredictBatch(std::vector<NeuralNetworkInput> inputs) {
+    std::vector<std::future<NeuralNetworkOutput>> futures;
+    futures.reserve(inputs.size());
+    for (auto& input : inputs) {
+        futures.push_back(Enqueue(std::move(input)));
+    }
+    std::vector<NeuralNetworkOutput> outputs;
+    outputs.reserve(futures.size());
+    for (auto& future : futures) {
+        outputs.push_back(future.get());
+    }
+    return outputs;
+}
+
+void SurakartaAlphazeroNeuralNetworkBatched::Train(std::unique_ptr<std::vector<TrainEntry>> train_data) {
+    model_->Train(std::move(train_data));
+}
+
+void SurakartaAlphazeroNeuralNetworkBatched::SaveModel(const std::string& model_path) {
+    model_->SaveModel(model_path);
+}
+
+void SurakartaAlphazeroNeuralNetworkBatched::ServeLoop(Queue& queue) {
+    while (true) {
+        std::vector<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.condition.wait(lock, [&queue]() { return queue.stopping || !queue.pending.empty(); });
+            if (queue.pending.empty())
+                return;  // stopping and nothing left to serve
+            const auto deadline = queue.pending.front().enqueue_time + flush_timeout_;
+            queue.condition.wait_until(lock, deadline, [this, &queue]() {
+                return queue.stopping || queue.pending.size() >= max_batch_size_;
+            });
+            const auto batch_size = std::min(queue.pending.size(), max_batch_size_);
+            batch.reserve(batch_size);
+            std::move(queue.pending.begin(), queue.pending.begin() + batch_size, std::back_inserter(batch));
+            queue.pending.erase(queue.pending.begin(), queue.pending.begin() + batch_size);
+        }
+
+        auto& metrics = SurakartaAlphazeroMetrics::Global();
+        if (metrics.Enabled()) {
+            metrics.Add(SurakartaAlphazeroMetrics::Counter::BATCHES);
+            metrics.Add(SurakartaAlphazeroMetrics::Counter::BATCHED_POSITIONS, batch.size());
+            metrics.Add(SurakartaAlphazeroMetrics::Counter::BATCH_CAPACITY, max_batch_size_);
+        }
+
+        std::vector<NeuralNetworkInput> inputs;
+        inputs.reserve(batch.size());
+        for (auto& request : batch) {
+            inputs.push_back(std::move(request.input));
+        }
+        std::vector<NeuralNetworkOutput> outputs;
+        try {
+            outputs = model_->PredictBatch(std::move(inputs));
+        } catch (...) {
+            for (auto& request : batch) {
+                request.promise.set_exception(std::current_exception());
+            }
+            continue;
+        }
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch[i].promise.set_value(std::move(outputs[i]));
+        }
+    }
+}
@@ -0,0 +1,151 @@
+#include "surakarta_alphazero_neural_network_cache.h"
+#include <algorithm>
+
+SurakartaAlphazeroNeuralNetworkCache::SurakartaAlphazeroNeuralNetworkCache(
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+    size_t capacity)
+    : model_(model),
+      shard_capacity_(std::max<size_t>(capacity / kShardCount, 1)),
+      version_(0),
+      hit_count_(0),
+      miss_count_(0) {}
+
+static uint64_t Mix(uint64_t hash, uint64_t value) {
+    // splitmix64 finalizer over the running hash
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// Straight from the position, without encoding it
+SurakartaAlphazeroNeuralNetworkCache::InputKey SurakartaAlphazeroNeuralNetworkCache::KeyOf(const NeuralNetworkInput& input) {
+    return {input.position.Pieces(input.my_color), input.position.Pieces(ReverseColor(input.my_color)),
+            input.position.num_round, input.position.last_captured_round};
+}
+
+uint64_t SurakartaAlphazeroNeuralNetworkCache::Hash(const InputKey& key) {
+    uint64_t hash = Mix(0, key.mine);
+    hash = Mix(hash, key.theirs);
+    return Mix(hash, (static_cast<uint64_t>(key.num_round) << 32) | key.last_captured_round);
+}
+
+bool SurakartaAlphazeroNeuralNetworkCache::Lookup(const InputKey& key,
+                                                  uint64_t hash,
+                                                  const std::vector<SurakartaMove>& legal_moves,
+                                                  NeuralNetworkOutput& output) {
+    auto& shard = ShardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto found = shard.index.find(hash);
+    if (found == shard.index.end() || found->second->key != key) {
+        return false;
+    }
+    if (found->second->version != version_) {
+        shard.entries.erase(found->second);
+        shard.index.erase(found);
+        return false;
+    }
+    const auto& priors = found->second->priors;
+    if (priors.size() != legal_moves.size()) {
+        return false;
+    }
+    auto move_probabilities = std::make_unique<std::vector<MoveWithProbability>>();
+    move_probabilities->reserve(legal_moves.size());
+    for (size_t i = 0; i < legal_moves.size(); i++) {
+        const int move_index = MoveToIndex(legal_moves[i]);
+        // Callers list the moves in the same order almost always, so the prior is looked for where the move is first
+        auto prior = priors.begin() + i;
+        if (prior->move_index != move_index) {
+            prior = std::find_if(priors.begin(), priors.end(),
+                                 [move_index](const CachedPrior& cached) { return cached.move_index == move_index; });
+            if (prior == priors.end()) {
+                return false;
+            }
+        }
+        move_probabilities->push_back({legal_moves[i], prior->probability});
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    output.move_probabilities = std::move(move_probabilities);
+    output.current_status_value = found->second->current_status_value;
+    return true;
+}
+
+void SurakartaAlphazeroNeuralNetworkCache::Store(const InputKey& key, uint64_t hash, uint64_t version, const NeuralNetworkOutput& output) {
+    auto& shard = ShardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // A colliding input replaces the one stored under its hash
+    const auto found = shard.index.find(hash);
+    if (found != shard.index.end()) {
+        shard.entries.erase(found->second);
+        shard.index.erase(found);
+    }
+    std::vector<CachedPrior> priors;
+    priors.reserve(output.move_probabilities->size());
+    for (const auto& move_with_probability : *output.move_probabilities) {
+        priors.push_back({MoveToIndex(move_with_probability.move), move_with_probability.probability});
+    }
+    shard.entries.push_front({hash, key, version, std::move(priors), output.current_status_value});
+    shard.index[hash] = shard.entries.begin();
+    if (shard.entries.size() > shard_capacity_) {
+        shard.index.erase(shard.entries.back().hash);
+        shard.entries.pop_back();
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput
+SurakartaAlphazeroNeuralNetworkCache::Predict(NeuralNetworkInput input) {
+    const auto key = KeyOf(input);
+    const auto hash = Hash(key);
+    NeuralNetworkOutput output;
+    if (Lookup(key, hash, input.legal_moves, output)) {
+        hit_count_++;
+        return output;
+    }
+    miss_count_++;
+    // Outputs of a model that was retrained meanwhile are stored as already stale
+    const auto version = version_.load();
+    output = model_->Predict(std::move(input));
+    Store(key, hash, version, output);
+    return output;
+}
+
+std::vector<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput>
+SurakartaAlphazeroNeuralNetworkCache::PredictBatch(std::vector<NeuralNetworkInput> inputs) {
+    std::vector<NeuralNetworkOutput> outputs(inputs.size());
+    std::vector<InputKey> miss_keys;
+    std::vector<uint64_t> miss_hashes;
+    std::vector<size_t> miss_indexes;
+    std::vector<NeuralNetworkInput> miss_inputs;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const auto key = KeyOf(inputs[i]);
+        const auto hash = Hash(key);
+        if (Lookup(key, hash, inputs[i].legal_moves, outputs[i])) {
+            hit_count_++;
+        } else {
+            miss_count_++;
+            miss_keys.push_back(key);
+            miss_hashes.push_back(hash);
+            miss_indexes.push_back(i);
+            miss_inputs.push_back(std::move(inputs[i]));
+        }
+    }
+    if (miss_inputs.empty()) {
+        return outputs;
+    }
+    const auto version = version_.load();
+    auto miss_outputs = model_->PredictBatch(std::move(miss_inputs));
+    for (size_t i = 0; i < miss_outputs.size(); i++) {
+        Store(miss_keys[i], miss_hashes[i], version, miss_outputs[i]);
+        outputs[miss_indexes[i]] = std::move(miss_outputs[i]);
+    }
+    return outputs;
+}
+
+void SurakartaAlphazeroNeuralNetworkCache::Train(std::unique_ptr<std::vector<TrainEntry>> train_data) {
+    model_->Train(std::move(train_data));
+    Invalidate();
+}
+
+void SurakartaAlphazeroNeuralNetworkCache::SaveModel(const std::string& model_path) {
+    model_->SaveModel(model_path);
+}
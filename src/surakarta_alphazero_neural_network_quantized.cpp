@@ -0,0 +1,498 @@
+#include "surakarta_alphazero_neural_network_quantized.h"
+#include "surakarta_alphazero_neural_network_architecture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SURAKARTA_ALPHAZERO_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SURAKARTA_ALPHAZERO_TARGET_AVX2
+#define SURAKARTA_ALPHAZERO_TARGET_AVX2_F16C
+#else
+#define SURAKARTA_ALPHAZERO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SURAKARTA_ALPHAZERO_TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#endif
+#endif
+
+static constexpr char kMagic[8] = {'S', 'K', 'Q', 'U', 'A', 'N', 'T', '\0'};
+static constexpr uint32_t kVersion = 1;
+static constexpr int kPadding = 16;  // Row lengths are multiples of this
+
+static int Pad(int size) {
+    return (size + kPadding - 1) / kPadding * kPadding;
+}
+
+static uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const uint32_t float_exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (float_exponent == 0xff) {
+        return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);  // Infinity or NaN
+    }
+    const int exponent = static_cast<int>(float_exponent) - 127 + 15;
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    // Round to nearest, ties to even; a carry out of the mantissa correctly bumps the exponent
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | static_cast<uint16_t>(half);
+}
+
+static float HalfToFloat(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal: shift until the leading bit becomes the implicit one
+        uint32_t shift = 0;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            shift++;
+        }
+        bits = sign | ((127 - 14 - shift) << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// @brief Every half precision value as a float, so that the scalar kernel converts with a load.
+static const float* HalfTable() {
+    static const std::vector<float> table = []() {
+        std::vector<float> values(1 << 16);
+        for (uint32_t half = 0; half < values.size(); half++) {
+            values[half] = HalfToFloat(static_cast<uint16_t>(half));
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+static float DotInt8Scalar(const int8_t* weights, const float* input, int size) {
+    float sum_0 = 0, sum_1 = 0, sum_2 = 0, sum_3 = 0;
+    for (int i = 0; i < size; i += 4) {
+        sum_0 += weights[i] * input[i];
+        sum_1 += weights[i + 1] * input[i + 1];
+        sum_2 += weights[i + 2] * input[i + 2];
+        sum_3 += weights[i + 3] * input[i + 3];
+    }
+    return (sum_0 + sum_1) + (sum_2 + sum_3);
+}
+
+static float DotFp16Scalar(const uint16_t* weights, const float* input, int size) {
+    const float* table = HalfTable();
+    float sum_0 = 0, sum_1 = 0, sum_2 = 0, sum_3 = 0;
+    for (int i = 0; i < size; i += 4) {
+        sum_0 += table[weights[i]] * input[i];
+        sum_1 += table[weights[i + 1]] * input[i + 1];
+        sum_2 += table[weights[i + 2]] * input[i + 2];
+        sum_3 += table[weights[i + 3]] * input[i + 3];
+    }
+    return (sum_0 + sum_1) + (sum_2 + sum_3);
+}
+
+#ifdef SURAKARTA_ALPHAZERO_X86
+
+SURAKARTA_ALPHAZERO_TARGET_AVX2 static inline float HorizontalSumAvx2(__m256 sum) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+
+SURAKARTA_ALPHAZERO_TARGET_AVX2 static float DotInt8Avx2(const int8_t* weights, const float* input, int size) {
+    __m256 sum_0 = _mm256_setzero_ps();
+    __m256 sum_1 = _mm256_setzero_ps();
+    for (int i = 0; i < size; i += 16) {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+        const __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(packed));
+        const __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(packed, 8)));
+        sum_0 = _mm256_fmadd_ps(low, _mm256_loadu_ps(input + i), sum_0);
+        sum_1 = _mm256_fmadd_ps(high, _mm256_loadu_ps(input + i + 8), sum_1);
+    }
+    return HorizontalSumAvx2(_mm256_add_ps(sum_0, sum_1));
+}
+
+SURAKARTA_ALPHAZERO_TARGET_AVX2_F16C static float DotFp16Avx2(const uint16_t* weights, const float* input, int size) {
+    __m256 sum_0 = _mm256_setzero_ps();
+    __m256 sum_1 = _mm256_setzero_ps();
+    for (int i = 0; i < size; i += 16) {
+        const __m256 low = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+        const __m256 high = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i + 8)));
+        sum_0 = _mm256_fmadd_ps(low, _mm256_loadu_ps(input + i), sum_0);
+        sum_1 = _mm256_fmadd_ps(high, _mm256_loadu_ps(input + i + 8), sum_1);
+    }
+    return HorizontalSumAvx2(_mm256_add_ps(sum_0, sum_1));
+}
+
+static bool SupportsF16c() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 29)) != 0;
+#else
+    return __builtin_cpu_supports("f16c");
+#endif
+}
+
+#endif
+
+static float Activate(SurakartaAlphazeroNeuralNetworkSnapshot::Activation activation, float x) {
+    switch (activation) {
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Activation::SIGMOID:
+            return 1.0f / (1.0f + std::exp(-x));
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Activation::IDENTITY:
+            return x;
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Activation::TANH:
+        default:
+            return std::tanh(x);
+    }
+}
+
+template <typename T>
+static void WriteValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void WriteValues(std::ofstream& file, const T* values, size_t count) {
+    file.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+}
+
+template <typename T>
+static void ReadValues(std::ifstream& file, T* values, size_t count) {
+    if (!file.read(reinterpret_cast<char*>(values), sizeof(T) * count)) {
+        throw std::runtime_error("Truncated quantized model");
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkQuantized::QuantizedLayer SurakartaAlphazeroNeuralNetworkQuantized::Quantize(
+    const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& layer) const {
+    QuantizedLayer quantized;
+    quantized.input_size = layer.input_size;
+    quantized.output_size = layer.output_size;
+    quantized.stride = Pad(layer.input_size);
+    quantized.activation = layer.activation;
+    quantized.biases = layer.biases;
+    const size_t padded_size = static_cast<size_t>(layer.output_size) * quantized.stride;
+    if (precision_ == Precision::INT8) {
+        // Symmetric, one scale per output row, so that a row with small weights keeps its resolution
+        quantized.int8_weights.assign(padded_size, 0);
+        quantized.scales.resize(layer.output_size);
+        for (int o = 0; o < layer.output_size; o++) {
+            const float* row = layer.weights.data() + static_cast<size_t>(o) * layer.input_size;
+            float max_magnitude = 0;
+            for (int i = 0; i < layer.input_size; i++) {
+                max_magnitude = std::max(max_magnitude, std::abs(row[i]));
+            }
+            const float scale = max_magnitude > 0 ? max_magnitude / 127.0f : 1.0f;
+            quantized.scales[o] = scale;
+            for (int i = 0; i < layer.input_size; i++) {
+                const float level = std::round(row[i] / scale);
+                quantized.int8_weights[static_cast<size_t>(o) * quantized.stride + i] =
+                    static_cast<int8_t>(std::max(-127.0f, std::min(127.0f, level)));
+            }
+        }
+    } else {
+        quantized.fp16_weights.assign(padded_size, 0);
+        for (int o = 0; o < layer.output_size; o++) {
+            for (int i = 0; i < layer.input_size; i++) {
+                quantized.fp16_weights[static_cast<size_t>(o) * quantized.stride + i] =
+                    FloatToHalf(layer.weights[static_cast<size_t>(o) * layer.input_size + i]);
+            }
+        }
+    }
+    return quantized;
+}
+
+SurakartaAlphazeroNeuralNetworkQuantized::SurakartaAlphazeroNeuralNetworkQuantized(
+    Precision precision,
+    const std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer>& trunk,
+    const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& policy_head,
+    const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& value_head)
+    : precision_(precision), max_stride_(0), use_avx2_(false) {
+    for (const auto& layer : trunk) {
+        trunk_.push_back(Quantize(layer));
+    }
+    policy_head_ = Quantize(policy_head);
+    value_head_ = Quantize(value_head);
+    Prepare("The exported model");
+}
+
+SurakartaAlphazeroNeuralNetworkQuantized::SurakartaAlphazeroNeuralNetworkQuantized(const std::string& model_path)
+    : precision_(Precision::INT8), max_stride_(0), use_avx2_(false) {
+    std::ifstream file(model_path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open quantized model " + model_path);
+    }
+    char magic[sizeof(kMagic)];
+    uint32_t version, precision, trunk_size;
+    ReadValues(file, magic, sizeof(magic));
+    ReadValues(file, &version, 1);
+    if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || version != kVersion) {
+        throw std::runtime_error(model_path + " is not a quantized model");
+    }
+    ReadValues(file, &precision, 1);
+    ReadValues(file, &trunk_size, 1);
+    if (precision > static_cast<uint32_t>(Precision::FP16)) {
+        throw std::runtime_error(model_path + " has an unknown precision");
+    }
+    precision_ = static_cast<Precision>(precision);
+    const auto read_layer = [&]() {
+        QuantizedLayer layer;
+        int32_t header[3];
+        ReadValues(file, header, 3);
+        if (header[0] <= 0 || header[1] <= 0 || header[2] < 0 ||
+            header[2] > static_cast<int32_t>(SurakartaAlphazeroNeuralNetworkSnapshot::Activation::IDENTITY)) {
+            throw std::runtime_error(model_path + " has a malformed layer");
+        }
+        layer.input_size = header[0];
+        layer.output_size = header[1];
+        layer.stride = Pad(layer.input_size);
+        layer.activation = static_cast<SurakartaAlphazeroNeuralNetworkSnapshot::Activation>(header[2]);
+        layer.biases.resize(layer.output_size);
+        ReadValues(file, layer.biases.data(), layer.biases.size());
+        const size_t padded_size = static_cast<size_t>(layer.output_size) * layer.stride;
+        if (precision_ == Precision::INT8) {
+            layer.scales.resize(layer.output_size);
+            ReadValues(file, layer.scales.data(), layer.scales.size());
+            layer.int8_weights.assign(padded_size, 0);
+            for (int o = 0; o < layer.output_size; o++) {
+                ReadValues(file, layer.int8_weights.data() + static_cast<size_t>(o) * layer.stride, layer.input_size);
+            }
+        } else {
+            layer.fp16_weights.assign(padded_size, 0);
+            for (int o = 0; o < layer.output_size; o++) {
+                ReadValues(file, layer.fp16_weights.data() + static_cast<size_t>(o) * layer.stride, layer.input_size);
+            }
+        }
+        return layer;
+    };
+    for (uint32_t i = 0; i < trunk_size; i++) {
+        trunk_.push_back(read_layer());
+    }
+    policy_head_ = read_layer();
+    value_head_ = read_layer();
+    Prepare(model_path);
+}
+
+void SurakartaAlphazeroNeuralNetworkQuantized::Prepare(const std::string& model_path) {
+    bool valid = !trunk_.empty() && trunk_.front().input_size == kEncodedInputSize &&
+                 policy_head_.output_size == kPolicySize && value_head_.output_size == 1 &&
+                 policy_head_.input_size == trunk_.back().output_size &&
+                 value_head_.input_size == trunk_.back().output_size;
+    for (size_t i = 1; i < trunk_.size(); i++) {
+        valid = valid && trunk_[i].input_size == trunk_[i - 1].output_size;
+    }
+    if (!valid) {
+        throw std::runtime_error(model_path + " has an unsupported architecture");
+    }
+    max_stride_ = 0;
+    for (const auto& layer : trunk_) {
+        max_stride_ = std::max(max_stride_, std::max(layer.stride, Pad(layer.output_size)));
+    }
+#ifdef SURAKARTA_ALPHAZERO_X86
+    use_avx2_ = SurakartaAlphazeroNeuralNetworkSnapshot::BestKernel() >= SurakartaAlphazeroNeuralNetworkSnapshot::Kernel::AVX2 &&
+                (precision_ == Precision::INT8 || SupportsF16c());
+#endif
+}
+
+void SurakartaAlphazeroNeuralNetworkQuantized::Export(
+    const std::string& model_path,
+    Precision precision,
+    const std::vector<SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer>& trunk,
+    const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& policy_head,
+    const SurakartaAlphazeroNeuralNetworkSnapshot::DenseLayer& value_head) {
+    SurakartaAlphazeroNeuralNetworkQuantized(precision, trunk, policy_head, value_head).SaveModel(model_path);
+}
+
+void SurakartaAlphazeroNeuralNetworkQuantized::SaveModel(const std::string& model_path) {
+    std::ofstream file(model_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Cannot write quantized model " + model_path);
+    }
+    // Little-endian, as the replay buffer: the formats are only read on the machines that write them
+    WriteValues(file, kMagic, sizeof(kMagic));
+    WriteValue(file, kVersion);
+    WriteValue(file, static_cast<uint32_t>(precision_));
+    WriteValue(file, static_cast<uint32_t>(trunk_.size()));
+    const auto write_layer = [&](const QuantizedLayer& layer) {
+        const int32_t header[3] = {layer.input_size, layer.output_size, static_cast<int32_t>(layer.activation)};
+        WriteValues(file, header, 3);
+        WriteValues(file, layer.biases.data(), layer.biases.size());
+        if (precision_ == Precision::INT8) {
+            WriteValues(file, layer.scales.data(), layer.scales.size());
+            for (int o = 0; o < layer.output_size; o++) {
+                WriteValues(file, layer.int8_weights.data() + static_cast<size_t>(o) * layer.stride, layer.input_size);
+            }
+        } else {
+            for (int o = 0; o < layer.output_size; o++) {
+                WriteValues(file, layer.fp16_weights.data() + static_cast<size_t>(o) * layer.stride, layer.input_size);
+            }
+        }
+    };
+    for (const auto& layer : trunk_) {
+        write_layer(layer);
+    }
+    write_layer(policy_head_);
+    write_layer(value_head_);
+    if (!file) {
+        throw std::runtime_error("Cannot write quantized model " + model_path);
+    }
+}
+
+size_t SurakartaAlphazeroNeuralNetworkQuantized::WeightBytes() const {
+    size_t bytes = 0;
+    const auto count = [&bytes](const QuantizedLayer& layer) {
+        bytes += static_cast<size_t>(layer.output_size) * layer.input_size *
+                 (layer.int8_weights.empty() ? sizeof(uint16_t) : sizeof(int8_t));
+        bytes += (layer.scales.size() + layer.biases.size()) * sizeof(float);
+    };
+    for (const auto& layer : trunk_) {
+        count(layer);
+    }
+    count(policy_head_);
+    count(value_head_);
+    return bytes;
+}
+
+float SurakartaAlphazeroNeuralNetworkQuantized::Evaluate(const QuantizedLayer& layer, const float* input, int output) const {
+    const size_t offset = static_cast<size_t>(output) * layer.stride;
+    float sum;
+    if (precision_ == Precision::INT8) {
+#ifdef SURAKARTA_ALPHAZERO_X86
+        sum = use_avx2_ ? DotInt8Avx2(layer.int8_weights.data() + offset, input, layer.stride)
+                        : DotInt8Scalar(layer.int8_weights.data() + offset, input, layer.stride);
+#else
+        sum = DotInt8Scalar(layer.int8_weights.data() + offset, input, layer.stride);
+#endif
+        sum *= layer.scales[output];
+    } else {
+#ifdef SURAKARTA_ALPHAZERO_X86
+        sum = use_avx2_ ? DotFp16Avx2(layer.fp16_weights.data() + offset, input, layer.stride)
+                        : DotFp16Scalar(layer.fp16_weights.data() + offset, input, layer.stride);
+#else
+        sum = DotFp16Scalar(layer.fp16_weights.data() + offset, input, layer.stride);
+#endif
+    }
+    return Activate(layer.activation, sum + layer.biases[output]);
+}
+
+SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput SurakartaAlphazeroNeuralNetworkQuantized::Predict(NeuralNetworkInput input) {
+    // Zero padded, so that the kernels can run over whole rows
+    std::vector<float> current(max_stride_, 0.0f);
+    std::vector<float> next(max_stride_, 0.0f);
+    EncodeInput(input, current.data());
+    for (const auto& layer : trunk_) {
+        for (int o = 0; o < layer.output_size; o++) {
+            next[o] = Evaluate(layer, current.data(), o);
+        }
+        std::fill(next.begin() + layer.output_size, next.end(), 0.0f);
+        current.swap(next);
+    }
+    std::vector<float> policy(input.legal_moves.size());
+    for (size_t i = 0; i < input.legal_moves.size(); i++) {
+        policy[i] = Evaluate(policy_head_, current.data(), MoveToIndex(input.legal_moves[i]));
+    }
+    if (policy_head_.activation == SurakartaAlphazeroNeuralNetworkSnapshot::Activation::IDENTITY) {
+        // A softmax policy head, see SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput
+        SurakartaAlphazeroNeuralNetworkArchitecture::Softmax(policy.data(), policy.size());
+    }
+    NeuralNetworkOutput output;
+    output.move_probabilities = std::make_unique<std::vector<MoveWithProbability>>(input.legal_moves.size());
+    for (size_t i = 0; i < input.legal_moves.size(); i++) {
+        (*output.move_probabilities)[i].move = input.legal_moves[i];
+        (*output.move_probabilities)[i].probability = policy[i];
+    }
+    output.current_status_value = Evaluate(value_head_, current.data(), 0);
+    return output;
+}
+
+void SurakartaAlphazeroNeuralNetworkQuantized::Train(std::unique_ptr<std::vector<TrainEntry>>) {
+    throw std::logic_error("A quantized model cannot be trained");
+}
+
+SurakartaAlphazeroNeuralNetworkQuantized::AccuracyReport SurakartaAlphazeroNeuralNetworkQuantized::CheckAccuracy(
+    SurakartaAlphazeroNeuralNetworkBase& reference,
+    SurakartaAlphazeroNeuralNetworkBase& candidate,
+    const std::vector<NeuralNetworkInput>& inputs) {
+    AccuracyReport report{inputs.size(), 0, 0, 0, 0, 0};
+    size_t policy_count = 0;
+    size_t agreements = 0;
+    for (const auto& input : inputs) {
+        const auto expected = reference.Predict(input);
+        const auto actual = candidate.Predict(input);
+        size_t expected_best = 0;
+        size_t actual_best = 0;
+        for (size_t i = 0; i < input.legal_moves.size(); i++) {
+            const double expected_probability = (*expected.move_probabilities)[i].probability;
+            const double actual_probability = (*actual.move_probabilities)[i].probability;
+            const double error = std::abs(expected_probability - actual_probability);
+            report.policy_max_error = std::max(report.policy_max_error, error);
+            report.policy_mean_error += error;
+            policy_count++;
+            if (expected_probability > (*expected.move_probabilities)[expected_best].probability) {
+                expected_best = i;
+            }
+            if (actual_probability > (*actual.move_probabilities)[actual_best].probability) {
+                actual_best = i;
+            }
+        }
+        if (expected_best == actual_best) {
+            agreements++;
+        }
+        const double value_error = std::abs(expected.current_status_value - actual.current_status_value);
+        report.value_max_error = std::max(report.value_max_error, value_error);
+        report.value_mean_error += value_error;
+    }
+    if (policy_count > 0) {
+        report.policy_mean_error /= policy_count;
+    }
+    if (!inputs.empty()) {
+        report.value_mean_error /= inputs.size();
+        report.top_move_agreement = static_cast<double>(agreements) / inputs.size();
+    }
+    return report;
+}
+
+std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> SurakartaAlphazeroNeuralNetworkQuantizedFactory::CreateModel(
+    const std::string&) {
+    throw std::logic_error("Quantized models are exported from trained models, see SurakartaAlphazeroNeuralNetworkFactory::ExportQuantized");
+}
+
+std::unique_ptr<SurakartaAlphazeroNeuralNetworkBase> SurakartaAlphazeroNeuralNetworkQuantizedFactory::LoadModel(
+    const std::string& model_path) {
+    return std::make_unique<SurakartaAlphazeroNeuralNetworkQuantized>(model_path);
+}
@@ -0,0 +1,282 @@
+#include "surakarta_alphazero_neural_network_snapshot.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SURAKARTA_ALPHAZERO_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC accepts the intrinsics of any instruction set without per-function targets
+#define SURAKARTA_ALPHAZERO_TARGET_AVX2
+#define SURAKARTA_ALPHAZERO_TARGET_AVX512
+#else
+#define SURAKARTA_ALPHAZERO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SURAKARTA_ALPHAZERO_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+// All kernels take rows of a multiple of 16 floats, aligned to 64 bytes, padded with zeros
+
+/// @brief Dot products of one weight row with one input.
+typedef float (*DotFunction)(const float* row, const float* input, int size);
+/// @brief Dot products of one weight row with 4 inputs, input_stride floats apart.
+typedef void (*Dot4Function)(const float* row, const float* inputs, int input_stride, int size, float* results);
+
+static float DotScalar(const float* a, const float* b, int size) {
+    // Independent partial sums, so that the additions do not wait on each other
+    float sum_0 = 0, sum_1 = 0, sum_2 = 0, sum_3 = 0;
+    for (int i = 0; i < size; i += 4) {
+        sum_0 += a[i] * b[i];
+        sum_1 += a[i + 1] * b[i + 1];
+        sum_2 += a[i + 2] * b[i + 2];
+        sum_3 += a[i + 3] * b[i + 3];
+    }
+    return (sum_0 + sum_1) + (sum_2 + sum_3);
+}
+
+static void Dot4Scalar(const float* row, const float* inputs, int input_stride, int size, float* results) {
+    for (int k = 0; k < 4; k++) {
+        results[k] = DotScalar(row, inputs + k * input_stride, size);
+    }
+}
+
+#ifdef SURAKARTA_ALPHAZERO_X86
+
+SURAKARTA_ALPHAZERO_TARGET_AVX2 static inline float HorizontalSumAvx2(__m256 sum) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+
+SURAKARTA_ALPHAZERO_TARGET_AVX2 static float DotAvx2(const float* a, const float* b, int size) {
+    __m256 sum_0 = _mm256_setzero_ps();
+    __m256 sum_1 = _mm256_setzero_ps();
+    for (int i = 0; i < size; i += 16) {
+        sum_0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_load_ps(b + i), sum_0);
+        sum_1 = _mm256_fmadd_ps(_mm256_load_ps(a + i + 8), _mm256_load_ps(b + i + 8), sum_1);
+    }
+    return HorizontalSumAvx2(_mm256_add_ps(sum_0, sum_1));
+}
+
+SURAKARTA_ALPHAZERO_TARGET_AVX2 static void Dot4Avx2(const float* row, const float* inputs, int input_stride, int size, float* results) {
+    __m256 sums[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    for (int i = 0; i < size; i += 8) {
+        const __m256 weights = _mm256_load_ps(row + i);
+        for (int k = 0; k < 4; k++) {
+            sums[k] = _mm256_fmadd_ps(weights, _mm256_load_ps(inputs + k * input_stride + i), sums[k]);
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        results[k] = HorizontalSumAvx2(sums[k]);
+    }
+}
+
+SURAKARTA_ALPHAZERO_TARGET_AVX512 static float DotAvx512(const float* a, const float* b, int size) {
+    __m512 sum = _mm512_setzero_ps();
+    for (int i = 0; i < size; i += 16) {
+        sum = _mm512_fmadd_ps(_mm512_load_ps(a + i), _mm512_load_ps(b + i), sum);
+    }
+    return _mm512_reduce_add_ps(sum);
+}
+
+SURAKARTA_ALPHAZERO_TARGET_AVX512 static void Dot4Avx512(const float* row, const float* inputs, int input_stride, int size, float* results) {
+    __m512 sums[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps()};
+    for (int i = 0; i < size; i += 16) {
+        const __m512 weights = _mm512_load_ps(row + i);
+        for (int k = 0; k < 4; k++) {
+            sums[k] = _mm512_fmadd_ps(weights, _mm512_load_ps(inputs + k * input_stride + i), sums[k]);
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        results[k] = _mm512_reduce_add_ps(sums[k]);
+    }
+}
+
+static bool SupportsAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return fma && os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+static bool SupportsAvx512() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool os_saves_zmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0xe6) == 0xe6;
+    __cpuidex(info, 7, 0);
+    return os_saves_zmm && (info[1] & (1 << 16)) != 0;
+#else
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#endif
+
+static DotFunction DotOf(SurakartaAlphazeroNeuralNetworkSnapshot::Kernel kernel) {
+    switch (kernel) {
+#ifdef SURAKARTA_ALPHAZERO_X86
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Kernel::AVX512:
+            return DotAvx512;
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Kernel::AVX2:
+            return DotAvx2;
+#endif
+        default:
+            return DotScalar;
+    }
+}
+
+static Dot4Function Dot4Of(SurakartaAlphazeroNeuralNetworkSnapshot::Kernel kernel) {
+    switch (kernel) {
+#ifdef SURAKARTA_ALPHAZERO_X86
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Kernel::AVX512:
+            return Dot4Avx512;
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Kernel::AVX2:
+            return Dot4Avx2;
+#endif
+        default:
+            return Dot4Scalar;
+    }
+}
+
+static float Activate(SurakartaAlphazeroNeuralNetworkSnapshot::Activation activation, float x) {
+    switch (activation) {
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Activation::SIGMOID:
+            return 1.0f / (1.0f + std::exp(-x));
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Activation::IDENTITY:
+            return x;
+        case SurakartaAlphazeroNeuralNetworkSnapshot::Activation::TANH:
+        default:
+            return std::tanh(x);
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkSnapshot::Kernel SurakartaAlphazeroNeuralNetworkSnapshot::BestKernel() {
+#ifdef SURAKARTA_ALPHAZERO_X86
+    static const Kernel best = SupportsAvx512() ? Kernel::AVX512 : SupportsAvx2() ? Kernel::AVX2
+                                                                                : Kernel::SCALAR;
+    return best;
+#else
+    return Kernel::SCALAR;
+#endif
+}
+
+const char* SurakartaAlphazeroNeuralNetworkSnapshot::KernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::AVX512:
+            return "avx512";
+        case Kernel::AVX2:
+            return "avx2";
+        case Kernel::SCALAR:
+        default:
+            return "scalar";
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkSnapshot::PackedLayer::PackedLayer(const DenseLayer& layer)
+    : input_size(layer.input_size),
+      output_size(layer.output_size),
+      stride(Pad(layer.input_size)),
+      weights(static_cast<size_t>(layer.output_size) * Pad(layer.input_size), 0.0f),
+      biases(layer.biases),
+      activation(layer.activation) {
+    for (int o = 0; o < output_size; o++) {
+        std::copy_n(layer.weights.begin() + static_cast<size_t>(o) * input_size, input_size,
+                    weights.begin() + static_cast<size_t>(o) * stride);
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkSnapshot::SurakartaAlphazeroNeuralNetworkSnapshot(
+    uint64_t version,
+    const std::vector<DenseLayer>& trunk,
+    const DenseLayer& policy_head,
+    const DenseLayer& value_head,
+    Kernel kernel)
+    : version_(version),
+      kernel_(std::min(kernel, BestKernel())),
+      trunk_(trunk.begin(), trunk.end()),
+      policy_head_(policy_head),
+      value_head_(value_head),
+      max_stride_(policy_head_.stride) {
+    for (const auto& layer : trunk_) {
+        max_stride_ = std::max(max_stride_, std::max(layer.stride, Pad(layer.output_size)));
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkSnapshot::AlignedVector* SurakartaAlphazeroNeuralNetworkSnapshot::RunTrunk(
+    size_t count,
+    AlignedVector& buffer_0,
+    AlignedVector& buffer_1) const {
+    const auto dot = DotOf(kernel_);
+    const auto dot_4 = Dot4Of(kernel_);
+    AlignedVector* current = &buffer_0;
+    AlignedVector* next = &buffer_1;
+    for (const auto& layer : trunk_) {
+        for (int o = 0; o < layer.output_size; o++) {
+            // Every row is loaded once for 4 inputs, and then stays in the cache for the rest
+            const float* row = layer.weights.data() + static_cast<size_t>(o) * layer.stride;
+            size_t b = 0;
+            for (; b + 4 <= count; b += 4) {
+                float sums[4];
+                dot_4(row, current->data() + b * max_stride_, max_stride_, layer.stride, sums);
+                for (int k = 0; k < 4; k++) {
+                    (*next)[(b + k) * max_stride_ + o] = Activate(layer.activation, sums[k] + layer.biases[o]);
+                }
+            }
+            for (; b < count; b++) {
+                const float sum = dot(row, current->data() + b * max_stride_, layer.stride);
+                (*next)[b * max_stride_ + o] = Activate(layer.activation, sum + layer.biases[o]);
+            }
+        }
+        // Padding beyond output_size must be zero for the next layer; a narrower layer leaves stale values
+        for (size_t b = 0; b < count; b++) {
+            std::fill(next->begin() + b * max_stride_ + layer.output_size, next->begin() + (b + 1) * max_stride_, 0.0f);
+        }
+        std::swap(current, next);
+    }
+    return current;
+}
+
+void SurakartaAlphazeroNeuralNetworkSnapshot::Forward(const float* features,
+                                                     const int* policy_indexes,
+                                                     size_t policy_count,
+                                                     float* policy,
+                                                     float* value) const {
+    const std::vector<int> indexes(policy_indexes, policy_indexes + policy_count);
+    std::vector<float> policies;
+    ForwardBatch(1, features, &indexes, &policies, value);
+    std::copy(policies.begin(), policies.end(), policy);
+}
+
+void SurakartaAlphazeroNeuralNetworkSnapshot::ForwardBatch(size_t count,
+                                                          const float* features,
+                                                          const std::vector<int>* policy_indexes,
+                                                          std::vector<float>* policies,
+                                                          float* values) const {
+    const int feature_size = trunk_.empty() ? policy_head_.input_size : trunk_.front().input_size;
+    AlignedVector buffer_0(count * max_stride_, 0.0f);
+    AlignedVector buffer_1(count * max_stride_, 0.0f);
+    for (size_t b = 0; b < count; b++) {
+        std::copy_n(features + b * feature_size, feature_size, buffer_0.begin() + b * max_stride_);
+    }
+    const auto trunk_output = RunTrunk(count, buffer_0, buffer_1);
+    const auto dot = DotOf(kernel_);
+    for (size_t b = 0; b < count; b++) {
+        const float* input = trunk_output->data() + b * max_stride_;
+        policies[b].resize(policy_indexes[b].size());
+        for (size_t i = 0; i < policy_indexes[b].size(); i++) {
+            const int o = policy_indexes[b][i];
+            const float sum = dot(policy_head_.weights.data() + static_cast<size_t>(o) * policy_head_.stride, input, policy_head_.stride);
+            policies[b][i] = Activate(policy_head_.activation, sum + policy_head_.biases[o]);
+        }
+        values[b] = Activate(value_head_.activation, dot(value_head_.weights.data(), input, value_head_.stride) + value_head_.biases[0]);
+    }
+}
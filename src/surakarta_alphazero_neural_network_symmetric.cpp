@@ -0,0 +1,134 @@
+#include "surakarta_alphazero_neural_network_symmetric.h"
+#include <cassert>
+#include <random>
+#include "surakarta_alphazero_symmetry.h"
+
+SurakartaAlphazeroNeuralNetworkSymmetric::SurakartaAlphazeroNeuralNetworkSymmetric(
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+    Inference inference,
+    bool augment_training)
+    : model_(model), inference_(inference), augment_training_(augment_training) {}
+
+SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput SurakartaAlphazeroNeuralNetworkSymmetric::TransformInput(
+    int symmetry,
+    const NeuralNetworkInput& input) {
+    NeuralNetworkInput transformed;
+    transformed.position = SurakartaAlphazeroSymmetry::TransformPosition(symmetry, input.position);
+    transformed.my_color = input.my_color;
+    transformed.legal_moves.reserve(input.legal_moves.size());
+    for (const auto& move : input.legal_moves) {
+        transformed.legal_moves.push_back(SurakartaAlphazeroSymmetry::TransformMove(symmetry, move));
+    }
+    return transformed;
+}
+
+int SurakartaAlphazeroNeuralNetworkSymmetric::RandomSymmetry() {
+    thread_local std::mt19937 random_engine(std::random_device{}());
+    return std::uniform_int_distribution<int>(0, SurakartaAlphazeroSymmetry::kCount - 1)(random_engine);
+}
+
+void SurakartaAlphazeroNeuralNetworkSymmetric::RestoreMoves(const NeuralNetworkInput& input, NeuralNetworkOutput& output) {
+    // The priors come in the order of the legal moves, so mapping back is just restoring the moves
+    assert(output.move_probabilities->size() == input.legal_moves.size());
+    for (size_t i = 0; i < input.legal_moves.size(); i++) {
+        (*output.move_probabilities)[i].move = input.legal_moves[i];
+    }
+}
+
+SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput SurakartaAlphazeroNeuralNetworkSymmetric::Predict(NeuralNetworkInput input) {
+    if (inference_ == Inference::AVERAGE) {
+        std::vector<NeuralNetworkInput> inputs;
+        inputs.push_back(std::move(input));
+        return std::move(PredictBatch(std::move(inputs))[0]);
+    }
+    if (inference_ == Inference::NONE) {
+        return model_->Predict(std::move(input));
+    }
+    auto output = model_->Predict(TransformInput(RandomSymmetry(), input));
+    RestoreMoves(input, output);
+    return output;
+}
+
+std::vector<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput> SurakartaAlphazeroNeuralNetworkSymmetric::PredictBatch(
+    std::vector<NeuralNetworkInput> inputs) {
+    if (inference_ == Inference::NONE) {
+        return model_->PredictBatch(std::move(inputs));
+    }
+    if (inference_ == Inference::RANDOM) {
+        // One symmetry per input, all evaluated in a single batch
+        std::vector<NeuralNetworkInput> transformed_inputs;
+        transformed_inputs.reserve(inputs.size());
+        for (const auto& input : inputs) {
+            transformed_inputs.push_back(TransformInput(RandomSymmetry(), input));
+        }
+        auto outputs = model_->PredictBatch(std::move(transformed_inputs));
+        for (size_t i = 0; i < inputs.size(); i++) {
+            RestoreMoves(inputs[i], outputs[i]);
+        }
+        return outputs;
+    }
+    constexpr int kCount = SurakartaAlphazeroSymmetry::kCount;
+    std::vector<NeuralNetworkInput> transformed_inputs;
+    transformed_inputs.reserve(inputs.size() * kCount);
+    for (const auto& input : inputs) {
+        for (int symmetry = 0; symmetry < kCount; symmetry++) {
+            transformed_inputs.push_back(TransformInput(symmetry, input));
+        }
+    }
+    auto transformed_outputs = model_->PredictBatch(std::move(transformed_inputs));
+    std::vector<NeuralNetworkOutput> outputs;
+    outputs.reserve(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const auto& legal_moves = inputs[i].legal_moves;
+        NeuralNetworkOutput output;
+        output.move_probabilities = std::make_unique<std::vector<MoveWithProbability>>();
+        output.move_probabilities->reserve(legal_moves.size());
+        for (const auto& move : legal_moves) {
+            output.move_probabilities->push_back({move, 0.0f});
+        }
+        output.current_status_value = 0.0f;
+        for (int symmetry = 0; symmetry < kCount; symmetry++) {
+            const auto& transformed = transformed_outputs[i * kCount + symmetry];
+            assert(transformed.move_probabilities->size() == legal_moves.size());
+            for (size_t j = 0; j < legal_moves.size(); j++) {
+                (*output.move_probabilities)[j].probability += (*transformed.move_probabilities)[j].probability / kCount;
+            }
+            output.current_status_value += transformed.current_status_value / kCount;
+        }
+        outputs.push_back(std::move(output));
+    }
+    return outputs;
+}
+
+std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> SurakartaAlphazeroNeuralNetworkSymmetric::Augment(
+    const std::vector<TrainEntry>& train_data) {
+    auto augmented = std::make_unique<std::vector<TrainEntry>>();
+    augmented->reserve(train_data.size() * SurakartaAlphazeroSymmetry::kCount);
+    for (const auto& entry : train_data) {
+        for (int symmetry = 0; symmetry < SurakartaAlphazeroSymmetry::kCount; symmetry++) {
+            TrainEntry transformed;
+            transformed.input = std::make_unique<NeuralNetworkInput>(TransformInput(symmetry, *entry.input));
+            transformed.output = std::make_unique<NeuralNetworkOutput>();
+            transformed.output->move_probabilities = std::make_unique<std::vector<MoveWithProbability>>();
+            transformed.output->move_probabilities->reserve(entry.output->move_probabilities->size());
+            for (const auto& move_probability : *entry.output->move_probabilities) {
+                transformed.output->move_probabilities->push_back(
+                    {SurakartaAlphazeroSymmetry::TransformMove(symmetry, move_probability.move), move_probability.probability});
+            }
+            transformed.output->current_status_value = entry.output->current_status_value;
+            augmented->push_back(std::move(transformed));
+        }
+    }
+    return augmented;
+}
+
+void SurakartaAlphazeroNeuralNetworkSymmetric::Train(std::unique_ptr<std::vector<TrainEntry>> train_data) {
+    if (augment_training_) {
+        train_data = Augment(*train_data);
+    }
+    model_->Train(std::move(train_data));
+}
+
+void SurakartaAlphazeroNeuralNetworkSymmetric::SaveModel(const std::string& model_path) {
+    model_->SaveModel(model_path);
+}
@@ -0,0 +1,37 @@
+#include "surakarta_alphazero_position_corpus.h"
+#include <random>
+
+std::vector<SurakartaAlphazeroPositionCorpus::Position> SurakartaAlphazeroPositionCorpus::Generate(int count,
+                                                                                                 unsigned int seed,
+                                                                                                 int max_plies) {
+    std::mt19937 random_engine(seed);
+    std::vector<Position> positions;
+    while (static_cast<int>(positions.size()) < count) {
+        SurakartaGame game(BOARD_SIZE, MAX_NO_CAPTURE_ROUND);
+        game.StartGame();
+        const int plies = static_cast<int>(random_engine() % (max_plies + 1));
+        for (int i = 0; i < plies && !game.IsEnd(); i++) {
+            SurakartaGetAllLegalMovesUtil legal_moves_util(game.GetBoard());
+            const auto moves = legal_moves_util.GetAllLegalMoves(game.GetGameInfo()->current_player_);
+            if (moves->empty()) {
+                break;
+            }
+            game.Move((*moves)[random_engine() % moves->size()]);
+        }
+        if (game.IsEnd()) {
+            continue;
+        }
+        positions.push_back({std::make_shared<SurakartaBoard>(*game.GetBoard()),
+                             std::make_shared<SurakartaGameInfo>(*game.GetGameInfo())});
+    }
+    return positions;
+}
+
+SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput SurakartaAlphazeroPositionCorpus::MakeInput(const Position& position) {
+    SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput input;
+    input.position = SurakartaAlphazeroPosition(*position.board, *position.game_info);
+    input.my_color = position.game_info->current_player_;
+    SurakartaGetAllLegalMovesUtil legal_moves_util(position.board);
+    input.legal_moves = std::move(*legal_moves_util.GetAllLegalMoves(input.my_color));
+    return input;
+}
@@ -0,0 +1,260 @@
+#include "surakarta_alphazero_replay_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(SurakartaAlphazeroNeuralNetworkBase::kPolicySize <= 65536, "A move index must fit in 16 bits");
+
+static constexpr char kMagic[8] = {'S', 'K', 'R', 'P', 'L', 'A', 'Y', '\0'};
+static constexpr uint32_t kFormatVersion = 1;
+
+SurakartaAlphazeroReplayRecord SurakartaAlphazeroReplayRecord::Encode(
+    const SurakartaAlphazeroNeuralNetworkBase::TrainEntry& entry) {
+    SurakartaAlphazeroReplayRecord record;
+    std::memset(&record, 0, sizeof(record));
+    const auto& position = entry.input->position;
+    record.black_plane = position.black;
+    record.white_plane = position.white;
+    record.num_round = position.num_round;
+    record.last_captured_round = position.last_captured_round;
+    record.outcome = entry.output->current_status_value;
+    record.side_to_move = entry.input->my_color == PieceColor::WHITE ? 1 : 0;
+
+    auto policy = *entry.output->move_probabilities;
+    if (policy.size() > kMaxPolicySize) {
+        std::partial_sort(policy.begin(), policy.begin() + kMaxPolicySize, policy.end(),
+                          [](const auto& a, const auto& b) { return a.probability > b.probability; });
+        policy.resize(kMaxPolicySize);
+    }
+    record.policy_size = policy.size();
+    for (size_t i = 0; i < policy.size(); i++) {
+        record.policy_moves[i] = SurakartaAlphazeroNeuralNetworkBase::MoveToIndex(policy[i].move);
+        record.policy_probabilities[i] = std::lround(std::clamp(policy[i].probability, 0.0f, 1.0f) * 65535.0f);
+    }
+    return record;
+}
+
+SurakartaAlphazeroNeuralNetworkBase::TrainEntry SurakartaAlphazeroReplayRecord::Decode() const {
+    const auto my_color = side_to_move == 1 ? PieceColor::WHITE : PieceColor::BLACK;
+    SurakartaAlphazeroNeuralNetworkBase::TrainEntry entry;
+    entry.input = std::make_unique<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkInput>();
+    entry.input->position.black = black_plane;
+    entry.input->position.white = white_plane;
+    entry.input->position.num_round = num_round;
+    entry.input->position.last_captured_round = last_captured_round;
+    entry.input->position.current_player = my_color;
+    entry.input->my_color = my_color;
+
+    entry.output = std::make_unique<SurakartaAlphazeroNeuralNetworkBase::NeuralNetworkOutput>();
+    entry.output->current_status_value = outcome;
+    entry.output->move_probabilities = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::MoveWithProbability>>(policy_size);
+    for (int i = 0; i < policy_size; i++) {
+        const int index = policy_moves[i];
+        auto& move_with_probability = (*entry.output->move_probabilities)[i];
+        move_with_probability.move = SurakartaMove(
+            index / (BOARD_SIZE * BOARD_SIZE) / BOARD_SIZE,
+            index / (BOARD_SIZE * BOARD_SIZE) % BOARD_SIZE,
+            index % (BOARD_SIZE * BOARD_SIZE) / BOARD_SIZE,
+            index % (BOARD_SIZE * BOARD_SIZE) % BOARD_SIZE,
+            my_color);
+        move_with_probability.probability = policy_probabilities[i] / 65535.0f;
+    }
+    return entry;
+}
+
+SurakartaAlphazeroReplayBuffer::SurakartaAlphazeroReplayBuffer(const std::string& path, size_t capacity)
+    : capacity_(capacity), header_(nullptr), mapped_size_(0) {
+#ifdef _WIN32
+    file_handle_ = INVALID_HANDLE_VALUE;
+    mapping_handle_ = nullptr;
+#else
+    file_descriptor_ = -1;
+#endif
+    const bool create = !std::filesystem::exists(path);
+    size_t file_size;
+    if (create) {
+        if (capacity == 0) {
+            throw std::runtime_error("Replay buffer capacity must be positive");
+        }
+        file_size = sizeof(FileHeader) + capacity * sizeof(SurakartaAlphazeroReplayRecord);
+    } else {
+        file_size = std::filesystem::file_size(path);
+        if (file_size < sizeof(FileHeader)) {
+            throw std::runtime_error("Not a replay buffer: " + path);
+        }
+    }
+    Map(path, file_size, create);
+    if (create) {
+        std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+        header_->version = kFormatVersion;
+        header_->record_size = sizeof(SurakartaAlphazeroReplayRecord);
+        header_->capacity = capacity;
+        header_->total_appended = 0;
+    } else if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 ||
+               header_->version != kFormatVersion ||
+               header_->record_size != sizeof(SurakartaAlphazeroReplayRecord) ||
+               sizeof(FileHeader) + header_->capacity * sizeof(SurakartaAlphazeroReplayRecord) != file_size) {
+        Unmap();
+        throw std::runtime_error("Not a replay buffer or written by an incompatible version: " + path);
+    }
+    capacity_ = header_->capacity;
+}
+
+SurakartaAlphazeroReplayBuffer::~SurakartaAlphazeroReplayBuffer() {
+    Flush();
+    Unmap();
+}
+
+#ifdef _WIN32
+
+void SurakartaAlphazeroReplayBuffer::Map(const std::string& path, size_t file_size, bool create) {
+    file_handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                               create ? CREATE_NEW : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle_ == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open replay buffer " + path);
+    }
+    // The mapping grows a new file to file_size, zero-filled
+    const auto size = static_cast<unsigned long long>(file_size);
+    mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READWRITE,
+                                         static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    if (mapping_handle_ == nullptr) {
+        Unmap();
+        throw std::runtime_error("Cannot map replay buffer " + path);
+    }
+    header_ = static_cast<FileHeader*>(MapViewOfFile(mapping_handle_, FILE_MAP_ALL_ACCESS, 0, 0, file_size));
+    if (header_ == nullptr) {
+        Unmap();
+        throw std::runtime_error("Cannot map replay buffer " + path);
+    }
+    mapped_size_ = file_size;
+}
+
+void SurakartaAlphazeroReplayBuffer::Unmap() {
+    if (header_ != nullptr) {
+        UnmapViewOfFile(header_);
+        header_ = nullptr;
+    }
+    if (mapping_handle_ != nullptr) {
+        CloseHandle(mapping_handle_);
+        mapping_handle_ = nullptr;
+    }
+    if (file_handle_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle_);
+        file_handle_ = INVALID_HANDLE_VALUE;
+    }
+}
+
+void SurakartaAlphazeroReplayBuffer::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (header_ != nullptr) {
+        FlushViewOfFile(header_, mapped_size_);
+        FlushFileBuffers(file_handle_);
+    }
+}
+
+#else
+
+void SurakartaAlphazeroReplayBuffer::Map(const std::string& path, size_t file_size, bool create) {
+    file_descriptor_ = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0644);
+    if (file_descriptor_ < 0) {
+        throw std::runtime_error("Cannot open replay buffer " + path);
+    }
+    if (create && ftruncate(file_descriptor_, file_size) != 0) {
+        Unmap();
+        throw std::runtime_error("Cannot allocate replay buffer " + path);
+    }
+    void* address = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor_, 0);
+    if (address == MAP_FAILED) {
+        Unmap();
+        throw std::runtime_error("Cannot map replay buffer " + path);
+    }
+    header_ = static_cast<FileHeader*>(address);
+    mapped_size_ = file_size;
+}
+
+void SurakartaAlphazeroReplayBuffer::Unmap() {
+    if (header_ != nullptr) {
+        munmap(header_, mapped_size_);
+        header_ = nullptr;
+    }
+    if (file_descriptor_ >= 0) {
+        close(file_descriptor_);
+        file_descriptor_ = -1;
+    }
+}
+
+void SurakartaAlphazeroReplayBuffer::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (header_ != nullptr) {
+        msync(header_, mapped_size_, MS_SYNC);
+    }
+}
+
+#endif
+
+SurakartaAlphazeroReplayRecord* SurakartaAlphazeroReplayBuffer::Records() const {
+    return reinterpret_cast<SurakartaAlphazeroReplayRecord*>(header_ + 1);
+}
+
+void SurakartaAlphazeroReplayBuffer::Append(const std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>& entries) {
+    std::vector<SurakartaAlphazeroReplayRecord> records;
+    records.reserve(entries.size());
+    for (const auto& entry : entries) {
+        records.push_back(SurakartaAlphazeroReplayRecord::Encode(entry));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& record : records) {
+        Records()[header_->total_appended % capacity_] = record;
+        header_->total_appended++;
+    }
+}
+
+std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> SurakartaAlphazeroReplayBuffer::Sample(
+    size_t count, Sampling sampling, std::mt19937& random_engine) const {
+    std::vector<SurakartaAlphazeroReplayRecord> records;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto total_appended = header_->total_appended;
+        const auto size = std::min<uint64_t>(total_appended, capacity_);
+        if (size > 0) {
+            records.reserve(count);
+            std::uniform_real_distribution<double> distribution(0.0, 1.0);
+            for (size_t i = 0; i < count; i++) {
+                // age 0 is the newest record. With RECENCY_WEIGHTED, 1 - sqrt(u) has a density
+                // falling linearly from 2 at age 0 to 0 at the oldest record.
+                const auto u = distribution(random_engine);
+                const auto age = std::min<uint64_t>(
+                    static_cast<uint64_t>((sampling == Sampling::UNIFORM ? u : 1.0 - std::sqrt(u)) * size), size - 1);
+                records.push_back(Records()[(total_appended - 1 - age) % capacity_]);
+            }
+        }
+    }
+    auto entries = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>>();
+    entries->reserve(records.size());
+    for (const auto& record : records) {
+        entries->push_back(record.Decode());
+    }
+    return entries;
+}
+
+size_t SurakartaAlphazeroReplayBuffer::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::min<uint64_t>(header_->total_appended, capacity_);
+}
+
+uint64_t SurakartaAlphazeroReplayBuffer::TotalAppended() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return header_->total_appended;
+}
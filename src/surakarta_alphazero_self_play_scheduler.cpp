@@ -0,0 +1,172 @@
+#include "surakarta_alphazero_self_play_scheduler.h"
+#include <algorithm>
+#include <utility>
+#include "surakarta_agent_alphazero.h"
+
+struct SurakartaAlphazeroSelfPlayScheduler::Game {
+    SurakartaGame game{BOARD_SIZE, MAX_NO_CAPTURE_ROUND};
+    std::unique_ptr<SurakartaAgentAlphazero> black;
+    std::unique_ptr<SurakartaAgentAlphazero> white;
+    std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> train_entries =
+        std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>>();
+};
+
+SurakartaAlphazeroSelfPlayScheduler::SurakartaAlphazeroSelfPlayScheduler(
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+    int simulation_per_move,
+    float cpuct,
+    float temperature,
+    int thread_count,
+    std::shared_ptr<const SurakartaAlphazeroThreadPlacement> placement,
+    size_t transposition_table_size)
+    : model_(model),
+      simulation_per_move_(simulation_per_move),
+      cpuct_(cpuct),
+      temperature_(temperature),
+      placement_(placement),
+      transposition_table_size_(transposition_table_size) {
+    for (int i = 0; i < std::max(thread_count, 1); i++) {
+        workers_.emplace_back([this, i]() { Work(i); });
+    }
+}
+
+SurakartaAlphazeroSelfPlayScheduler::~SurakartaAlphazeroSelfPlayScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::vector<SurakartaAlphazeroSelfPlayScheduler::GameResult> SurakartaAlphazeroSelfPlayScheduler::PlayGames(
+    int game_count, const std::function<void(const GameResult&)>& on_game_finished) {
+    std::vector<GameResult> results;
+    std::unique_lock<std::mutex> lock(mutex_);
+    running_ = true;
+    changed_.notify_all();
+    while (static_cast<int>(results.size()) < game_count && !exception_) {
+        changed_.wait(lock, [this]() { return exception_ || !finished_.empty(); });
+        const auto first_new = results.size();
+        while (!finished_.empty() && static_cast<int>(results.size()) < game_count) {
+            results.push_back(std::move(finished_.front()));
+            finished_.pop_front();
+        }
+        if (on_game_finished) {
+            lock.unlock();
+            for (auto i = first_new; i < results.size(); i++) {
+                on_game_finished(results[i]);
+            }
+            lock.lock();
+        }
+    }
+    // Let the moves being searched finish, so that nothing runs while the caller trains
+    running_ = false;
+    changed_.wait(lock, [this]() { return active_workers_ == 0; });
+    if (exception_) {
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+    return results;
+}
+
+void SurakartaAlphazeroSelfPlayScheduler::OnWeightsChanged() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    weights_version_++;
+}
+
+void SurakartaAlphazeroSelfPlayScheduler::SetValueTargets(
+    std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>& train_entries,
+    const SurakartaGameInfo& game_info) {
+    const auto winner = game_info.Winner();
+    for (auto& entry : train_entries) {
+        entry.output->current_status_value = winner == PieceColor::NONE                    ? 0.0f
+                                             : winner == entry.input->position.current_player ? 1.0f
+                                                                                             : -1.0f;
+    }
+}
+
+std::unique_ptr<SurakartaAlphazeroSelfPlayScheduler::Game> SurakartaAlphazeroSelfPlayScheduler::StartGame() {
+    auto game = std::make_unique<Game>();
+    game->game.StartGame();
+    const auto board = game->game.GetBoard();
+    const auto game_info = game->game.GetGameInfo();
+    game->black = std::make_unique<SurakartaAgentAlphazero>(board, game_info, nullptr, PieceColor::BLACK, model_,
+                                                            simulation_per_move_, cpuct_, temperature_, 1, transposition_table_size_);
+    game->white = std::make_unique<SurakartaAgentAlphazero>(board, game_info, nullptr, PieceColor::WHITE, model_,
+                                                            simulation_per_move_, cpuct_, temperature_, 1, transposition_table_size_);
+    const auto train_entries = game->train_entries.get();
+    const auto record = [train_entries](SurakartaAlphazeroMCTS& mcts) {
+        train_entries->push_back(mcts.GetTrainEntriesWithoutValue());
+    };
+    game->black->OnSimulationsFinished.AddListener(record);
+    game->white->OnSimulationsFinished.AddListener(record);
+    return game;
+}
+
+bool SurakartaAlphazeroSelfPlayScheduler::WaitForTurn(int& weights_version) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this]() { return stopping_ || (running_ && !exception_); });
+    if (stopping_) {
+        return false;
+    }
+    active_workers_++;
+    weights_version = weights_version_;
+    return true;
+}
+
+void SurakartaAlphazeroSelfPlayScheduler::Work(int worker) {
+    if (placement_) {
+        placement_->PinWorker(worker);
+    }
+    std::unique_ptr<Game> game;  // Paused here between two calls of PlayGames()
+    int game_weights_version = 0;  // The weights the trees and transposition tables of game were searched with
+    int weights_version = 0;
+    while (WaitForTurn(weights_version)) {
+        std::exception_ptr exception;
+        try {
+            if (game != nullptr && weights_version != game_weights_version) {
+                game->black->ResetSearch();
+                game->white->ResetSearch();
+            }
+            game_weights_version = weights_version;
+            if (game == nullptr) {
+                game = StartGame();
+            }
+            auto& agent = game->game.GetGameInfo()->current_player_ == PieceColor::BLACK ? game->black : game->white;
+            game->game.Move(agent->CalculateMove());
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        if (exception) {
+            // The game is dropped; PlayGames() rethrows
+            game.reset();
+        }
+        GameResult result;
+        const bool finished = game != nullptr && game->game.IsEnd();
+        if (finished) {
+            result.game_info = *game->game.GetGameInfo();
+            for (const auto* table : {game->black->TranspositionTable(), game->white->TranspositionTable()}) {
+                if (table != nullptr) {
+                    result.transposition_hits += table->HitCount();
+                    result.transposition_misses += table->MissCount();
+                }
+            }
+            SetValueTargets(*game->train_entries, result.game_info);
+            result.train_entries = std::move(game->train_entries);
+            game.reset();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_workers_--;
+            if (exception && !exception_) {
+                exception_ = exception;
+            }
+            if (finished) {
+                finished_.push_back(std::move(result));
+            }
+        }
+        changed_.notify_all();
+    }
+}
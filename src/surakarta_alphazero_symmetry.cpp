@@ -0,0 +1,81 @@
+#include "surakarta_alphazero_symmetry.h"
+
+namespace {
+
+constexpr int kCellCount = BOARD_SIZE * BOARD_SIZE;
+
+struct SymmetryTables {
+    int cells[SurakartaAlphazeroSymmetry::kCount][kCellCount];  // cells[s][x * BOARD_SIZE + y]: the cell (x, y) maps to
+
+    SymmetryTables() {
+        constexpr int last = BOARD_SIZE - 1;
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            for (int y = 0; y < BOARD_SIZE; y++) {
+                const int mapped[SurakartaAlphazeroSymmetry::kCount][2] = {
+                    {x, y},                // Identity
+                    {y, last - x},         // Rotation by 90 degrees
+                    {last - x, last - y},  // Rotation by 180 degrees
+                    {last - y, x},         // Rotation by 270 degrees
+                    {x, last - y},         // Reflection in the horizontal axis
+                    {y, x},                // Reflection in the main diagonal
+                    {last - x, y},         // Reflection in the vertical axis
+                    {last - y, last - x},  // Reflection in the anti-diagonal
+                };
+                for (int s = 0; s < SurakartaAlphazeroSymmetry::kCount; s++) {
+                    cells[s][x * BOARD_SIZE + y] = mapped[s][0] * BOARD_SIZE + mapped[s][1];
+                }
+            }
+        }
+    }
+};
+
+const SymmetryTables& Tables() {
+    static const SymmetryTables tables;
+    return tables;
+}
+
+uint64_t TransformBitboard(int symmetry, uint64_t bitboard) {
+    const auto& cells = Tables().cells[symmetry];
+    uint64_t transformed = 0;
+    while (bitboard != 0) {
+        int cell = 0;
+        while (((bitboard >> cell) & 1) == 0) {
+            cell++;
+        }
+        bitboard &= bitboard - 1;
+        transformed |= uint64_t(1) << cells[cell];
+    }
+    return transformed;
+}
+
+}  // namespace
+
+int SurakartaAlphazeroSymmetry::Inverse(int symmetry) {
+    // Only the quarter rotations are not their own inverse
+    return symmetry == 1 ? 3 : symmetry == 3 ? 1
+                                             : symmetry;
+}
+
+SurakartaPosition SurakartaAlphazeroSymmetry::TransformCell(int symmetry, const SurakartaPosition& cell) {
+    const int mapped = Tables().cells[symmetry][cell.x * BOARD_SIZE + cell.y];
+    return SurakartaPosition(mapped / BOARD_SIZE, mapped % BOARD_SIZE);
+}
+
+SurakartaAlphazeroPosition SurakartaAlphazeroSymmetry::TransformPosition(int symmetry, const SurakartaAlphazeroPosition& position) {
+    auto transformed = position;
+    transformed.black = TransformBitboard(symmetry, position.black);
+    transformed.white = TransformBitboard(symmetry, position.white);
+    return transformed;
+}
+
+SurakartaMove SurakartaAlphazeroSymmetry::TransformMove(int symmetry, const SurakartaMove& move) {
+    auto transformed = move;
+    transformed.from = TransformCell(symmetry, move.from);
+    transformed.to = TransformCell(symmetry, move.to);
+    return transformed;
+}
+
+int SurakartaAlphazeroSymmetry::TransformMoveIndex(int symmetry, int index) {
+    const auto& cells = Tables().cells[symmetry];
+    return cells[index / kCellCount] * kCellCount + cells[index % kCellCount];
+}
@@ -0,0 +1,168 @@
+#include "surakarta_alphazero_thread_placement.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+static thread_local int current_node = -1;
+
+#if defined(__linux__)
+/// @brief Parse a CPU list of sysfs, e.g. "0-3,8-11".
+static std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream stream(text);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        const auto dash = range.find('-');
+        try {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // An empty list, as memory-only nodes have
+        }
+    }
+    return cpus;
+}
+
+static std::vector<std::vector<int>> ReadTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return {};
+    }
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+        const auto name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string text;
+        std::getline(file, text);
+        std::vector<int> cpus;
+        // Only the CPUs this process may use, e.g. in a container or under taskset
+        for (const int cpu : ParseCpuList(text)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+    std::vector<std::vector<int>> topology;
+    for (auto& node : nodes) {
+        topology.push_back(std::move(node.second));
+    }
+    if (topology.empty()) {
+        // No NUMA information: one node of every allowed CPU
+        topology.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                topology.back().push_back(cpu);
+            }
+        }
+    }
+    return topology;
+}
+#endif
+
+const std::vector<std::vector<int>>& SurakartaAlphazeroThreadPlacement::Topology() {
+    static const std::vector<std::vector<int>> topology = []() {
+        std::vector<std::vector<int>> nodes;
+#if defined(__linux__)
+        nodes = ReadTopology();
+#endif
+        if (nodes.empty()) {
+            nodes.emplace_back();
+            for (int cpu = 0; cpu < static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)); cpu++) {
+                nodes.back().push_back(cpu);
+            }
+        }
+        return nodes;
+    }();
+    return topology;
+}
+
+SurakartaAlphazeroThreadPlacement::SurakartaAlphazeroThreadPlacement(Policy policy, int max_nodes)
+    : policy_(policy) {
+    const auto& topology = Topology();
+    if (policy == Policy::NONE) {
+        nodes_.emplace_back();
+        for (const auto& node : topology) {
+            nodes_.back().insert(nodes_.back().end(), node.begin(), node.end());
+        }
+        return;
+    }
+    const int node_count = max_nodes > 0 ? std::min<int>(max_nodes, topology.size()) : topology.size();
+    nodes_.assign(topology.begin(), topology.begin() + node_count);
+}
+
+void SurakartaAlphazeroThreadPlacement::PinWorker(int worker) const {
+    if (policy_ == Policy::NONE) {
+        return;
+    }
+    const int node = worker % NodeCount();
+    const auto& cpus = nodes_[node];
+    // The workers of a node take its CPUs in turn, and share them once there are more workers than CPUs
+    const bool pinned = policy_ == Policy::CORE ? Pin({cpus[worker / NodeCount() % cpus.size()]}) : Pin(cpus);
+    if (pinned) {
+        current_node = node;
+    }
+}
+
+void SurakartaAlphazeroThreadPlacement::PinToNode(int node) const {
+    node %= NodeCount();
+    if (policy_ != Policy::NONE && Pin(nodes_[node])) {
+        current_node = node;
+    }
+}
+
+int SurakartaAlphazeroThreadPlacement::CurrentNode() {
+    return current_node;
+}
+
+bool SurakartaAlphazeroThreadPlacement::Pin(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+const char* SurakartaAlphazeroThreadPlacement::PolicyName(Policy policy) {
+    switch (policy) {
+        case Policy::NODE:
+            return "node";
+        case Policy::CORE:
+            return "core";
+        case Policy::NONE:
+        default:
+            return "none";
+    }
+}
+
+bool SurakartaAlphazeroThreadPlacement::ParsePolicy(const std::string& name, Policy& policy) {
+    for (const auto candidate : {Policy::NONE, Policy::NODE, Policy::CORE}) {
+        if (name == PolicyName(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,20 @@
+#include "surakarta_alphazero_time_control.h"
+#include <algorithm>
+
+SurakartaAlphazeroMCTS::SearchLimits SurakartaAlphazeroTimeControl::Limits(std::chrono::steady_clock::time_point start,
+                                                                           std::chrono::milliseconds time_left) const {
+    SurakartaAlphazeroMCTS::SearchLimits limits;
+    limits.max_simulations = max_simulations;
+    limits.stop_early = stop_early;
+    if (mode == Mode::GAME_TIME) {
+        const auto reserve = std::max(time_left, std::chrono::milliseconds(0)) / 2;
+        const auto share = std::min(time_left / std::max(moves_to_go, 1) + increment, reserve);
+        const auto extended = std::chrono::duration_cast<std::chrono::milliseconds>(share * std::max(max_extension, 1.0f));
+        limits.soft_deadline = start + share;
+        limits.hard_deadline = start + std::min(extended, reserve);
+    } else {
+        limits.soft_deadline = start + move_time;
+        limits.hard_deadline = start + move_time;
+    }
+    return limits;
+}
@@ -1,64 +1,136 @@
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <filesystem>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 #include "surakarta.h"
 #include "surakarta_alphazero.h"
 
-void SurakartaAlphazeroTrainUtil::TrainSingleIteration(
-    std::shared_ptr<SurakartaLogger> logger,
-    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase::ModelFactory> model_factory,
-    std::string model_path) {
-    const int concurrency = std::thread::hardware_concurrency();
-    auto threads = std::make_unique<std::thread[]>(concurrency);
+static const char* WinnerName(const SurakartaGameInfo& game_info) {
+    return game_info.Winner() == PieceColor::NONE    ? "none"
+           : game_info.Winner() == PieceColor::WHITE ? "white"
+           : game_info.Winner() == PieceColor::BLACK ? "black"
+                                                     : "unknown";
+}
+
+std::unique_ptr<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>> SurakartaAlphazeroTrainUtil::PlayGame(
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+    int simulation_per_move,
+    float cpuct,
+    float temperature,
+    SurakartaGameInfo& game_info) {
+    auto factory = std::make_shared<SurakartaAgentAlphazeroFactory>(model, simulation_per_move, cpuct, temperature);
     auto train_entries = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>>();
-    std::mutex mutex;
-    logger->Log("Start %d games in parallel to collect data", concurrency);
-    for (int i = 0; i < concurrency; i++) {
-        threads[i] = std::thread([this, &train_entries, logger, &mutex, model_factory, model_path, i]() {
-            std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model;
-            if (!model_factory || model_path.empty()) {
-                model = model_;
-            } else {
-                model = model_factory->LoadModel(model_path);
-            }
-            auto factory = std::make_shared<SurakartaAgentAlphazeroFactory>(model, simulation_per_move_, cpuct_, temperature_);
-            auto train_entries_local = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>>();
-            factory->AddOnSimulationsFinishedHandler([&train_entries_local, &mutex](SurakartaAlphazeroMCTS& mcts) {
-                train_entries_local->push_back(mcts.GetTrainEntriesWithoutValue());
+    factory->AddOnSimulationsFinishedHandler([&train_entries](SurakartaAlphazeroMCTS& mcts) {
+        train_entries->push_back(mcts.GetTrainEntriesWithoutValue());
+    });
+    auto daemon = SurakartaDaemon(BOARD_SIZE, MAX_NO_CAPTURE_ROUND, factory, factory);
+    daemon.Execute();
+    game_info = daemon.CopyGameInfo();
+    SurakartaAlphazeroSelfPlayScheduler::SetValueTargets(*train_entries, game_info);
+    return train_entries;
+}
+
+std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> SurakartaAlphazeroTrainUtil::CreateInferenceStack(
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model,
+    int inference_batch_size,
+    std::chrono::microseconds inference_flush_timeout,
+    size_t inference_cache_size,
+    SurakartaAlphazeroNeuralNetworkSymmetric::Inference symmetric_inference,
+    bool augment_symmetries,
+    std::shared_ptr<const SurakartaAlphazeroThreadPlacement> thread_placement) {
+    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> stack = model;
+    if (inference_batch_size > 1) {
+        stack = std::make_shared<SurakartaAlphazeroNeuralNetworkBatched>(stack, inference_batch_size, inference_flush_timeout,
+                                                                         thread_placement);
+    }
+    // Below the cache, so that the cache keeps the averaged outputs
+    if (symmetric_inference != SurakartaAlphazeroNeuralNetworkSymmetric::Inference::NONE || augment_symmetries) {
+        stack = std::make_shared<SurakartaAlphazeroNeuralNetworkSymmetric>(stack, symmetric_inference, augment_symmetries);
+    }
+    if (inference_cache_size > 0) {
+        stack = std::make_shared<SurakartaAlphazeroNeuralNetworkCache>(stack, inference_cache_size);
+    }
+    return stack;
+}
+
+void SurakartaAlphazeroTrainUtil::TrainSingleIteration(std::shared_ptr<SurakartaLogger> logger) {
+    if (!self_play_scheduler_) {
+        // All games share one model: predictions read its weight snapshot without locking
+        self_play_scheduler_ = std::make_unique<SurakartaAlphazeroSelfPlayScheduler>(
+            shared_model_, simulation_per_move_, cpuct_, temperature_, self_play_threads_, thread_placement_,
+            transposition_table_size_);
+    }
+    auto train_entries = std::make_unique<std::vector<SurakartaAlphazeroNeuralNetworkBase::TrainEntry>>();
+    logger->Log("Play %d games on %d threads to collect data", games_per_iteration_, self_play_threads_);
+    int finished = 0;
+    size_t transposition_hits = 0;
+    size_t transposition_misses = 0;
+    std::vector<SurakartaAlphazeroSelfPlayScheduler::GameResult> results;
+    {
+        SurakartaAlphazeroMetrics::ScopedTimer self_play_timer(SurakartaAlphazeroMetrics::Counter::SELF_PLAY_MICROSECONDS);
+        results = self_play_scheduler_->PlayGames(
+            games_per_iteration_, [&](const SurakartaAlphazeroSelfPlayScheduler::GameResult& result) {
+                logger->Log(" - Game %d finished. total %d moves, winner: %s", finished++, result.game_info.num_round_,
+                            WinnerName(result.game_info));
             });
-            auto daemon = SurakartaDaemon(BOARD_SIZE, MAX_NO_CAPTURE_ROUND, factory, factory);
-            daemon.Execute();
-            const auto game_info = daemon.CopyGameInfo();
-            const auto winner = daemon.CopyGameInfo().Winner();
-            if (winner == PieceColor::NONE) {
-                for (auto& entry : *train_entries_local) {
-                    entry.output->current_status_value = 0.0f;
-                }
-            } else {
-                for (auto& entry : *train_entries_local) {
-                    entry.output->current_status_value = winner == entry.input->game_info.current_player_ ? 1.0f : -1.0f;
-                }
-            }
-            {
-                std::lock_guard<std::mutex> lock(mutex);
-                for (auto& entry : *train_entries_local) {
-                    train_entries->push_back(SurakartaAlphazeroNeuralNetworkBase::TrainEntry());
-                    train_entries->back().input = std::move(entry.input);
-                    train_entries->back().output = std::move(entry.output);
-                }
-                logger->Log(" - Game %d finished. total %d moves, winner: %s", i, game_info.num_round_,
-                            game_info.Winner() == PieceColor::NONE    ? "none"
-                            : game_info.Winner() == PieceColor::WHITE ? "white"
-                            : game_info.Winner() == PieceColor::BLACK ? "black"
-                                                                      : "unknown");
-            }
-        });
     }
-    for (int i = 0; i < concurrency; i++) {
-        threads[i].join();
+    for (auto& result : results) {
+        for (auto& entry : *result.train_entries) {
+            train_entries->push_back(std::move(entry));
+        }
+        transposition_hits += result.transposition_hits;
+        transposition_misses += result.transposition_misses;
+    }
+    if (transposition_table_size_ > 0) {
+        logger->Log("Transposition tables: %zu hits, %zu misses", transposition_hits, transposition_misses);
+    }
+    if (inference_cache_) {
+        logger->Log("Inference cache: %zu hits, %zu misses", inference_cache_->HitCount(), inference_cache_->MissCount());
+        inference_cache_->ResetCounters();
+    }
+    if (replay_buffer_) {
+        replay_buffer_->Append(*train_entries);
+        replay_buffer_->Flush();
+        const auto sample_count = replay_sample_count_ > 0 ? replay_sample_count_ : train_entries->size();
+        logger->Log("Replay buffer: %zu positions stored, %llu played in total", replay_buffer_->Size(),
+                    static_cast<unsigned long long>(replay_buffer_->TotalAppended()));
+        train_entries = replay_buffer_->Sample(sample_count, replay_sampling_, random_engine_);
     }
     logger->Log("All games finished. Start training with %d data", train_entries->size());
-    model_->Train(std::move(train_entries));
+    shared_model_->Train(std::move(train_entries));
+    self_play_scheduler_->OnWeightsChanged();
+}
+
+std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> SurakartaAlphazeroLoadTrainSaveUtil::LoadOrCreateModel(
+    const std::string& model_path,
+    std::shared_ptr<SurakartaLogger> logger) {
+    if (std::filesystem::exists(model_path)) {
+        logger->Log("Loading model from %s", model_path.c_str());
+        return model_factory_->LoadModel(model_path);
+    }
+    logger->Log("Model %s does not exist, creating a new model", model_path.c_str());
+    return model_factory_->CreateModel(model_path);
+}
+
+void SurakartaAlphazeroLoadTrainSaveUtil::ReportMetrics(int iteration, std::shared_ptr<SurakartaLogger> logger) {
+    const auto report = SurakartaAlphazeroMetrics::Global().Collect();
+    const auto& predict_latency = report.Get(SurakartaAlphazeroMetrics::Histogram::PREDICT_LATENCY_US);
+    const auto& lock_wait = report.Get(SurakartaAlphazeroMetrics::Histogram::MODEL_LOCK_WAIT_US);
+    logger->Log("Metrics: %.0f simulations/s, predict p50 %llu us p99 %llu us, batch fill %.2f, lock wait p99 %llu us, %.0f train samples/s",
+                report.SimulationsPerSecond(), static_cast<unsigned long long>(predict_latency.p50),
+                static_cast<unsigned long long>(predict_latency.p99), report.BatchFillRatio(),
+                static_cast<unsigned long long>(lock_wait.p99), report.TrainSamplesPerSecond());
+    if (report.gauge_set[static_cast<int>(SurakartaAlphazeroMetrics::Gauge::POLICY_LOSS)]) {
+        logger->Log("Metrics: policy loss %.4f, value loss %.4f",
+                    report.gauges[static_cast<int>(SurakartaAlphazeroMetrics::Gauge::POLICY_LOSS)],
+                    report.gauges[static_cast<int>(SurakartaAlphazeroMetrics::Gauge::VALUE_LOSS)]);
+    }
+    if (!metrics_path_.empty()) {
+        SurakartaAlphazeroMetrics::Write(metrics_path_, metrics_format_, report, iteration);
+    }
 }
 
 void SurakartaAlphazeroLoadTrainSaveUtil::Train(const std::string& model_path,
@@ -67,19 +139,126 @@ void SurakartaAlphazeroLoadTrainSaveUtil::Train(const std::string& model_path,
                                                 float cpuct,
                                                 float temperature,
                                                 std::shared_ptr<SurakartaLogger> logger) {
-    std::shared_ptr<SurakartaAlphazeroNeuralNetworkBase> model;
-    if (std::filesystem::exists(model_path)) {
-        logger->Log("Loading model from %s", model_path.c_str());
-        model = model_factory_->LoadModel(model_path);
-    } else {
-        logger->Log("Model %s does not exist, creating a new model", model_path.c_str());
-        model = model_factory_->CreateModel(model_path);
+    const auto model = LoadOrCreateModel(model_path, logger);
+    auto train_util = SurakartaAlphazeroTrainUtil(model, simulation_per_move, cpuct, temperature,
+                                                  inference_batch_size_, inference_flush_timeout_, inference_cache_size_,
+                                                  symmetric_inference_, augment_symmetries_, thread_placement_);
+    if (replay_buffer_) {
+        train_util.UseReplayBuffer(replay_buffer_, replay_sample_count_, replay_sampling_);
+    }
+    train_util.UseSelfPlaySchedule(games_per_iteration_, self_play_threads_);
+    train_util.UseTranspositionTable(transposition_table_size_);
+    if (use_metrics_) {
+        SurakartaAlphazeroMetrics::Global().Enable(true);
+        SurakartaAlphazeroMetrics::Global().Collect();
     }
-    auto train_util = SurakartaAlphazeroTrainUtil(model, simulation_per_move, cpuct, temperature);
     logger->Log("Start training. Total: %d iterations", iterations);
     for (int i = 0; i < iterations; i++) {
-        train_util.TrainSingleIteration(logger, model_factory_, model_path);
+        train_util.TrainSingleIteration(logger);
         model->SaveModel(model_path);
         logger->Log("Iteration %d/%d completed and new model saved to %s", i + 1, iterations, model_path.c_str());
+        if (use_metrics_) {
+            ReportMetrics(i + 1, logger);
+        }
+    }
+}
+
+void SurakartaAlphazeroLoadTrainSaveUtil::TrainPipelined(const std::string& model_path,
+                                                         int iterations,
+                                                         int actor_count,
+                                                         int save_interval,
+                                                         int simulation_per_move,
+                                                         float cpuct,
+                                                         float temperature,
+                                                         std::shared_ptr<SurakartaLogger> logger) {
+    if (!replay_buffer_) {
+        throw std::runtime_error("Pipelined training needs a replay buffer");
+    }
+    if (actor_count < 1) {
+        throw std::invalid_argument("Pipelined training needs at least one actor");
+    }
+    if (save_interval < 1) {
+        throw std::invalid_argument("The save interval must be at least 1 training step");
+    }
+    const auto model = LoadOrCreateModel(model_path, logger);
+    // The learner trains through the same stack the actors predict with, so that every step
+    // augments its data and invalidates the cache. Predictions never wait for training: each step
+    // ends by swapping in a new weight snapshot.
+    const auto shared_model = SurakartaAlphazeroTrainUtil::CreateInferenceStack(
+        model, inference_batch_size_, inference_flush_timeout_, inference_cache_size_, symmetric_inference_, augment_symmetries_,
+        thread_placement_);
+    std::mutex mutex;  // Guards games_played and actor_exception
+    std::condition_variable appended;
+    int games_played = 0;
+    std::exception_ptr actor_exception;
+    std::atomic<bool> stop(false);
+
+    if (use_metrics_) {
+        SurakartaAlphazeroMetrics::Global().Enable(true);
+        SurakartaAlphazeroMetrics::Global().Collect();
+    }
+    logger->Log("Start pipelined training with %d actors. Total: %d iterations", actor_count, iterations);
+    std::vector<std::thread> actors;
+    for (int i = 0; i < actor_count; i++) {
+        actors.emplace_back([&, i]() {
+            if (thread_placement_) {
+                thread_placement_->PinWorker(i);
+            }
+            try {
+                while (!stop) {
+                    SurakartaGameInfo game_info;
+                    const auto train_entries = SurakartaAlphazeroTrainUtil::PlayGame(shared_model, simulation_per_move, cpuct, temperature, game_info);
+                    replay_buffer_->Append(*train_entries);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    games_played++;
+                    logger->Log(" - Game %d finished. total %d moves, winner: %s", games_played, game_info.num_round_,
+                                WinnerName(game_info));
+                    appended.notify_one();
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!actor_exception) {
+                    actor_exception = std::current_exception();
+                }
+                stop = true;
+                appended.notify_one();
+            }
+        });
+    }
+
+    std::mt19937 random_engine(std::random_device{}());
+    uint64_t trained_until = replay_buffer_->TotalAppended();
+    for (int i = 0; i < iterations && !stop; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            appended.wait(lock, [&]() { return stop || replay_buffer_->TotalAppended() > trained_until; });
+        }
+        if (stop) {
+            break;
+        }
+        const auto total_appended = replay_buffer_->TotalAppended();
+        const auto sample_count = replay_sample_count_ > 0 ? replay_sample_count_ : total_appended - trained_until;
+        trained_until = total_appended;
+        auto train_entries = replay_buffer_->Sample(sample_count, replay_sampling_, random_engine);
+        logger->Log("Training step %d/%d with %zu data, %zu positions stored", i + 1, iterations,
+                    train_entries->size(), replay_buffer_->Size());
+        shared_model->Train(std::move(train_entries));
+        if ((i + 1) % save_interval == 0 || i + 1 == iterations) {
+            replay_buffer_->Flush();
+            model->SaveModel(model_path);
+            logger->Log("Model saved to %s", model_path.c_str());
+        }
+        if (use_metrics_) {
+            ReportMetrics(i + 1, logger);
+        }
+    }
+    stop = true;
+    logger->Log("Waiting for the actors to finish their games");
+    for (auto& actor : actors) {
+        actor.join();
+    }
+    replay_buffer_->Flush();
+    if (actor_exception) {
+        std::rethrow_exception(actor_exception);
     }
 }
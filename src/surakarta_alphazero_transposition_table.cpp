@@ -0,0 +1,134 @@
+#include "surakarta_alphazero_transposition_table.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+
+constexpr int kCellCount = BOARD_SIZE * BOARD_SIZE;
+constexpr int kMaxNoCaptureRound = 256;  // Longer streaks share the last key
+
+struct ZobristKeys {
+    uint64_t pieces[2][kCellCount];
+    uint64_t white_to_move;
+    uint64_t no_capture_rounds[kMaxNoCaptureRound];
+
+    ZobristKeys() {
+        std::mt19937_64 random_engine(0x5375726b61727461ULL);  // Fixed seed, hashes are stable across runs
+        for (auto& color_keys : pieces) {
+            for (auto& key : color_keys) {
+                key = random_engine();
+            }
+        }
+        white_to_move = random_engine();
+        for (auto& key : no_capture_rounds) {
+            key = random_engine();
+        }
+    }
+};
+
+const ZobristKeys& Keys() {
+    static const ZobristKeys keys;
+    return keys;
+}
+
+uint64_t PieceKey(PieceColor color, int x, int y) {
+    switch (color) {
+        case PieceColor::BLACK:
+            return Keys().pieces[0][x * BOARD_SIZE + y];
+        case PieceColor::WHITE:
+            return Keys().pieces[1][x * BOARD_SIZE + y];
+        default:
+            return 0;
+    }
+}
+
+uint64_t GameInfoKey(const SurakartaAlphazeroPosition& position) {
+    const auto no_capture_rounds = std::min<long long>(
+        std::max<long long>(static_cast<long long>(position.num_round) - position.last_captured_round, 0),
+        kMaxNoCaptureRound - 1);
+    return (position.current_player == PieceColor::WHITE ? Keys().white_to_move : 0) ^
+           Keys().no_capture_rounds[no_capture_rounds];
+}
+
+uint64_t PiecesKey(PieceColor color, uint64_t pieces) {
+    uint64_t key = 0;
+    for (int cell = 0; pieces != 0; cell++, pieces >>= 1) {
+        if (pieces & 1) {
+            key ^= PieceKey(color, cell / BOARD_SIZE, cell % BOARD_SIZE);
+        }
+    }
+    return key;
+}
+
+}  // namespace
+
+uint64_t SurakartaAlphazeroZobristHash::Hash(const SurakartaAlphazeroPosition& position) {
+    return PiecesKey(PieceColor::BLACK, position.black) ^ PiecesKey(PieceColor::WHITE, position.white) ^ GameInfoKey(position);
+}
+
+uint64_t SurakartaAlphazeroZobristHash::Update(uint64_t hash,
+                                               const SurakartaAlphazeroPosition& before,
+                                               const SurakartaAlphazeroPosition& after) {
+    // Only the few cells a move touches differ
+    return hash ^
+           PiecesKey(PieceColor::BLACK, before.black ^ after.black) ^
+           PiecesKey(PieceColor::WHITE, before.white ^ after.white) ^
+           GameInfoKey(before) ^ GameInfoKey(after);
+}
+
+SurakartaAlphazeroTranspositionTable::SurakartaAlphazeroTranspositionTable(size_t capacity)
+    : bucket_count_(std::max<size_t>(capacity / kBucketSize, 1)),
+      slots_(bucket_count_ * kBucketSize),
+      locks_(std::make_unique<std::mutex[]>(kLockCount)),
+      clock_(0),
+      hit_count_(0),
+      miss_count_(0) {}
+
+bool SurakartaAlphazeroTranspositionTable::Lookup(uint64_t hash, Entry& entry) {
+    const auto bucket = hash % bucket_count_;
+    std::lock_guard<std::mutex> lock(LockOf(bucket));
+    for (size_t i = 0; i < kBucketSize; i++) {
+        auto& slot = slots_[bucket * kBucketSize + i];
+        if (slot.used && slot.hash == hash) {
+            slot.last_used = ++clock_;
+            entry = slot.entry;
+            hit_count_++;
+            return true;
+        }
+    }
+    miss_count_++;
+    return false;
+}
+
+void SurakartaAlphazeroTranspositionTable::Store(uint64_t hash, float value, const float* priors, size_t prior_count) {
+    const auto bucket = hash % bucket_count_;
+    std::lock_guard<std::mutex> lock(LockOf(bucket));
+    Slot* target = &slots_[bucket * kBucketSize];
+    for (size_t i = 0; i < kBucketSize; i++) {
+        auto& slot = slots_[bucket * kBucketSize + i];
+        if (!slot.used || slot.hash == hash) {
+            target = &slot;
+            break;
+        }
+        if (slot.last_used < target->last_used) {
+            target = &slot;
+        }
+    }
+    target->used = true;
+    target->hash = hash;
+    target->last_used = ++clock_;
+    target->entry.value = value;
+    target->entry.priors.assign(priors, priors + prior_count);
+}
+
+void SurakartaAlphazeroTranspositionTable::Clear() {
+    for (size_t i = 0; i < kLockCount; i++) {
+        locks_[i].lock();
+    }
+    for (auto& slot : slots_) {
+        slot.used = false;
+    }
+    for (size_t i = 0; i < kLockCount; i++) {
+        locks_[i].unlock();
+    }
+}
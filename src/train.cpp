@@ -1,4 +1,7 @@
 #include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
 #include "surakarta_alphazero.h"
 
 int main(int argc, char** argv) {
@@ -12,6 +15,47 @@ int main(int argc, char** argv) {
         printf("        -t|--temperature <float> Temperature value, default = 1.0\n");
         printf("        -b|--batch <int>         Batch size, default = 1\n");
         printf("        -e|--epochs <int>        Number of epochs, default = 1\n");
+        printf("        --inference-backend <tiny-dnn|scalar|simd> How self-play runs the network, default = simd\n");
+        printf("                                 Residual models always run on tiny-dnn\n");
+        printf("        --architecture <dense|residual> Trunk of a new model, default = dense\n");
+        printf("        --width <int>            Units per dense layer or channels per convolution of a new model,\n");
+        printf("                                 default = 1335 for dense, 32 for residual\n");
+        printf("        --depth <int>            Dense layers or residual blocks of a new model, default = 5 for dense, 4 for residual\n");
+        printf("        --policy-head <dense|factorized> One output per move, or per from and to cell, default = dense\n");
+        printf("        --policy-output <sigmoid|softmax> Policy of a new model trained with MSE on sigmoids, or\n");
+        printf("                                 with cross-entropy on a softmax, default = sigmoid\n");
+        printf("        --learning-rate <float>  Adam learning rate, default = 0.001\n");
+        printf("        --l2 <float>             Weight decay per unit of learning rate, default = 0\n");
+        printf("        --lr-schedule <constant|step|cosine> Learning rate schedule, default = constant\n");
+        printf("        --lr-steps <int>         Training batches per step decay, or of the cosine decay, default = 10000\n");
+        printf("        --lr-decay <float>       Factor per step decay, or final factor of the cosine decay, default = 0.1\n");
+        printf("        --train-threads <int>    Threads splitting each training batch, up to the batch size, default = 1\n");
+        printf("        --inference-batch <int>  Max positions per batched forward pass during self-play, 1 = no batching, default = number of threads\n");
+        printf("        --inference-timeout <int> Microseconds to wait for a batch to fill up, default = 1000\n");
+        printf("        --inference-cache <int>  Network outputs cached during self-play, 0 = no cache, default = 0\n");
+        printf("        --symmetric-inference <none|random|average> Evaluate positions as they are, in a random symmetry\n");
+        printf("                                 or averaged over all 8 symmetries of the board, default = none\n");
+        printf("        --augment-symmetries     Train on every position in all 8 symmetries of the board\n");
+        printf("        --replay-buffer <path>   Keep self-play positions in this file and train on samples of it, default = none\n");
+        printf("        --replay-capacity <int>  Positions kept when a new replay buffer is created, default = 1000000\n");
+        printf("        --replay-sample <int>    Positions sampled per training step, 0 = as many as played, default = 0\n");
+        printf("        --replay-recency         Favour recent positions when sampling, default = uniform\n");
+        printf("        --pipeline               Play and train at the same time, iterations count training steps\n");
+        printf("                                 A replay buffer is needed, default = model_path.replay\n");
+        printf("        --actors <int>           Self-play threads in pipeline mode, default = number of threads - 1\n");
+        printf("        --save-interval <int>    Training steps between saving the model in pipeline mode, default = 1\n");
+        printf("        --games <int>            Games finished per iteration, default = number of threads\n");
+        printf("        --self-play-threads <int> Threads playing games, default = number of threads\n");
+        printf("        --transposition-table <int> Evaluations kept per self-play agent to reuse across move orders,\n");
+        printf("                                 0 = no table, not used with --pipeline, default = 0\n");
+        printf("        --thread-placement <none|node|core> Pin self-play and inference threads to the CPUs of a NUMA node,\n");
+        printf("                                 or to a single CPU of it, each node with its own copy of the weights\n");
+        printf("                                 and its own inference batches, default = none\n");
+        printf("        --numa-nodes <int>       NUMA nodes to place threads on, 0 = all, default = 0\n");
+        printf("        --metrics <path>         Log throughput, latency and loss figures of every iteration and write\n");
+        printf("                                 them to this file, default = none\n");
+        printf("        --metrics-format <json|prometheus> Append a JSON line per iteration, or replace a Prometheus\n");
+        printf("                                 textfile with the last iteration, default = json\n");
         printf("Example: %s model.bin -i 1 -s 5 -c 1.0 -t 1.0 -b 1 -e 1\n", argv[0]);
         return 1;
     }
@@ -21,6 +65,31 @@ int main(int argc, char** argv) {
     float temperature = 1.0f;
     int batch_size = 1;
     int epochs = 1;
+    auto inference_backend = SurakartaAlphazeroNeuralNetworkFactory::Backend::SIMD;
+    auto architecture = SurakartaAlphazeroNeuralNetworkArchitecture::Default();
+    SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions training_options;
+    int width = 0;  // 0 = the default of the trunk
+    int depth = 0;
+    int inference_batch_size = std::max<int>(std::thread::hardware_concurrency(), 1);
+    int inference_timeout = 1000;
+    int inference_cache_size = 0;
+    auto symmetric_inference = SurakartaAlphazeroNeuralNetworkSymmetric::Inference::NONE;
+    bool augment_symmetries = false;
+    std::string replay_buffer_path;
+    long long replay_capacity = 1000000;
+    long long replay_sample_count = 0;
+    bool replay_recency = false;
+    bool pipeline = false;
+    int actor_count = std::max<int>(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1);
+    int save_interval = 1;
+    const int thread_count = std::max<int>(std::thread::hardware_concurrency(), 1);
+    int games_per_iteration = thread_count;
+    int self_play_threads = thread_count;
+    long long transposition_table_size = 0;
+    auto thread_placement_policy = SurakartaAlphazeroThreadPlacement::Policy::NONE;
+    int numa_nodes = 0;
+    std::string metrics_path;
+    auto metrics_format = SurakartaAlphazeroMetrics::Format::JSON;
     for (int i = 2; i < argc; i++) {
         if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--iterations") == 0) {
             iterations = std::stoi(argv[++i]);
@@ -34,11 +103,143 @@ int main(int argc, char** argv) {
             batch_size = std::stoi(argv[++i]);
         } else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--epochs") == 0) {
             epochs = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--inference-backend") == 0) {
+            if (!SurakartaAlphazeroNeuralNetworkFactory::ParseBackend(argv[++i], inference_backend)) {
+                printf("Unknown inference backend %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--architecture") == 0) {
+            const char* trunk = argv[++i];
+            if (strcmp(trunk, "dense") == 0) {
+                architecture.trunk = SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::DENSE;
+            } else if (strcmp(trunk, "residual") == 0) {
+                architecture.trunk = SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::RESIDUAL;
+            } else {
+                printf("Unknown architecture %s\n", trunk);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--width") == 0) {
+            width = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            depth = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--policy-head") == 0) {
+            const char* head = argv[++i];
+            if (strcmp(head, "dense") == 0) {
+                architecture.policy_head = SurakartaAlphazeroNeuralNetworkArchitecture::PolicyHead::DENSE;
+            } else if (strcmp(head, "factorized") == 0) {
+                architecture.policy_head = SurakartaAlphazeroNeuralNetworkArchitecture::PolicyHead::FACTORIZED;
+            } else {
+                printf("Unknown policy head %s\n", head);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--policy-output") == 0) {
+            const char* output = argv[++i];
+            if (strcmp(output, "sigmoid") == 0) {
+                architecture.policy_output = SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput::SIGMOID;
+            } else if (strcmp(output, "softmax") == 0) {
+                architecture.policy_output = SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput::SOFTMAX;
+            } else {
+                printf("Unknown policy output %s\n", output);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--learning-rate") == 0) {
+            training_options.learning_rate = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--l2") == 0) {
+            training_options.l2 = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--lr-schedule") == 0) {
+            const char* schedule = argv[++i];
+            if (strcmp(schedule, "constant") == 0) {
+                training_options.schedule = SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions::Schedule::CONSTANT;
+            } else if (strcmp(schedule, "step") == 0) {
+                training_options.schedule = SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions::Schedule::STEP;
+            } else if (strcmp(schedule, "cosine") == 0) {
+                training_options.schedule = SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions::Schedule::COSINE;
+            } else {
+                printf("Unknown learning rate schedule %s\n", schedule);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--lr-steps") == 0) {
+            training_options.schedule_steps = std::stoll(argv[++i]);
+        } else if (strcmp(argv[i], "--lr-decay") == 0) {
+            training_options.decay = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--train-threads") == 0) {
+            training_options.threads = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--inference-batch") == 0) {
+            inference_batch_size = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--inference-timeout") == 0) {
+            inference_timeout = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--inference-cache") == 0) {
+            inference_cache_size = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--symmetric-inference") == 0) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "random") == 0) {
+                symmetric_inference = SurakartaAlphazeroNeuralNetworkSymmetric::Inference::RANDOM;
+            } else if (strcmp(mode, "average") == 0) {
+                symmetric_inference = SurakartaAlphazeroNeuralNetworkSymmetric::Inference::AVERAGE;
+            } else if (strcmp(mode, "none") == 0) {
+                symmetric_inference = SurakartaAlphazeroNeuralNetworkSymmetric::Inference::NONE;
+            } else {
+                printf("Unknown symmetric inference %s\n", mode);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--augment-symmetries") == 0) {
+            augment_symmetries = true;
+        } else if (strcmp(argv[i], "--replay-buffer") == 0) {
+            replay_buffer_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay-capacity") == 0) {
+            replay_capacity = std::stoll(argv[++i]);
+        } else if (strcmp(argv[i], "--replay-sample") == 0) {
+            replay_sample_count = std::stoll(argv[++i]);
+        } else if (strcmp(argv[i], "--replay-recency") == 0) {
+            replay_recency = true;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = true;
+        } else if (strcmp(argv[i], "--actors") == 0) {
+            actor_count = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save-interval") == 0) {
+            save_interval = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0) {
+            games_per_iteration = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--self-play-threads") == 0) {
+            self_play_threads = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--transposition-table") == 0) {
+            transposition_table_size = std::stoll(argv[++i]);
+        } else if (strcmp(argv[i], "--thread-placement") == 0) {
+            if (!SurakartaAlphazeroThreadPlacement::ParsePolicy(argv[++i], thread_placement_policy)) {
+                printf("Unknown thread placement %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--numa-nodes") == 0) {
+            numa_nodes = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-format") == 0) {
+            if (!SurakartaAlphazeroMetrics::ParseFormat(argv[++i], metrics_format)) {
+                printf("Unknown metrics format %s\n", argv[i]);
+                return 1;
+            }
         }
     }
 
-    auto train_util = SurakartaAlphazeroLoadTrainSaveUtil(
-        std::make_shared<SurakartaAlphazeroNeuralNetworkFactory>(batch_size, epochs));
+    const bool residual = architecture.trunk == SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::RESIDUAL;
+    architecture.width = width > 0 ? width : residual ? 32 : architecture.width;
+    architecture.depth = depth > 0 ? depth : residual ? 4 : architecture.depth;
+    if (!architecture.IsValid()) {
+        printf("Invalid architecture %s\n", architecture.ToString().c_str());
+        return 1;
+    }
+    if (pipeline && actor_count < 1) {
+        printf("Invalid number of actors %d, at least 1 is needed\n", actor_count);
+        return 1;
+    }
+    if (pipeline && save_interval < 1) {
+        printf("Invalid save interval %d, at least 1 is needed\n", save_interval);
+        return 1;
+    }
+
+    auto factory = std::make_shared<SurakartaAlphazeroNeuralNetworkFactory>(batch_size, epochs, inference_backend, architecture);
+    factory->UseTrainingOptions(training_options);
+    auto train_util = SurakartaAlphazeroLoadTrainSaveUtil(factory);
     auto logger = std::make_shared<SurakartaLoggerStdout>();
     logger->Log("Training model %s", argv[1]);
     logger->Log(" - Iterations:            %d", iterations);
@@ -47,7 +248,66 @@ int main(int argc, char** argv) {
     logger->Log(" - Temperature:           %f", temperature);
     logger->Log(" - Batch size:            %d", batch_size);
     logger->Log(" - Epochs:                %d", epochs);
-    train_util.Train(argv[1], iterations, simulation_per_move, cpuct, temperature, logger);
+    logger->Log(" - Learning rate:         %f (%s schedule)", training_options.learning_rate,
+                training_options.schedule == SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions::Schedule::STEP     ? "step"
+                : training_options.schedule == SurakartaAlphazeroNeuralNetworkFactory::TrainingOptions::Schedule::COSINE ? "cosine"
+                                                                                                                            : "constant");
+    logger->Log(" - L2:                    %f", training_options.l2);
+    logger->Log(" - Training threads:      %d", std::min(training_options.threads, batch_size));
+    const bool model_exists = std::filesystem::exists(argv[1]);
+    logger->Log(" - Model architecture:    %s%s",
+                (model_exists ? SurakartaAlphazeroNeuralNetworkArchitecture::Load(argv[1]) : architecture).ToString().c_str(),
+                model_exists ? "" : " (new)");
+    logger->Log(" - Inference backend:     %s", SurakartaAlphazeroNeuralNetworkFactory::BackendName(inference_backend));
+    if (inference_backend == SurakartaAlphazeroNeuralNetworkFactory::Backend::SIMD) {
+        logger->Log(" - SIMD kernel:           %s",
+                    SurakartaAlphazeroNeuralNetworkSnapshot::KernelName(SurakartaAlphazeroNeuralNetworkSnapshot::BestKernel()));
+    }
+    logger->Log(" - Inference batch size:  %d", inference_batch_size);
+    logger->Log(" - Inference timeout:     %d us", inference_timeout);
+    logger->Log(" - Inference cache size:  %d", inference_cache_size);
+    train_util.UseInference(inference_batch_size, std::chrono::microseconds(inference_timeout), inference_cache_size);
+    logger->Log(" - Symmetric inference:   %s",
+                symmetric_inference == SurakartaAlphazeroNeuralNetworkSymmetric::Inference::RANDOM    ? "random"
+                : symmetric_inference == SurakartaAlphazeroNeuralNetworkSymmetric::Inference::AVERAGE ? "average"
+                                                                                                      : "none");
+    logger->Log(" - Augment symmetries:    %s", augment_symmetries ? "yes" : "no");
+    train_util.UseSymmetries(symmetric_inference, augment_symmetries);
+    if (thread_placement_policy != SurakartaAlphazeroThreadPlacement::Policy::NONE) {
+        auto thread_placement = std::make_shared<SurakartaAlphazeroThreadPlacement>(thread_placement_policy, numa_nodes);
+        logger->Log(" - Thread placement:      %s, %d of %zu NUMA nodes", SurakartaAlphazeroThreadPlacement::PolicyName(thread_placement_policy),
+                    thread_placement->NodeCount(), SurakartaAlphazeroThreadPlacement::Topology().size());
+        train_util.UseThreadPlacement(thread_placement);
+    }
+    if (!metrics_path.empty()) {
+        logger->Log(" - Metrics:               %s (%s)", metrics_path.c_str(), SurakartaAlphazeroMetrics::FormatName(metrics_format));
+        train_util.UseMetrics(metrics_path, metrics_format);
+    }
+    if (pipeline && replay_buffer_path.empty()) {
+        replay_buffer_path = std::string(argv[1]) + ".replay";
+    }
+    if (!replay_buffer_path.empty()) {
+        auto replay_buffer = std::make_shared<SurakartaAlphazeroReplayBuffer>(replay_buffer_path, replay_capacity);
+        logger->Log(" - Replay buffer:         %s (%zu/%zu positions)", replay_buffer_path.c_str(),
+                    replay_buffer->Size(), replay_buffer->Capacity());
+        logger->Log(" - Replay sample size:    %lld", replay_sample_count);
+        logger->Log(" - Replay sampling:       %s", replay_recency ? "recency weighted" : "uniform");
+        train_util.UseReplayBuffer(replay_buffer, replay_sample_count,
+                                   replay_recency ? SurakartaAlphazeroReplayBuffer::Sampling::RECENCY_WEIGHTED
+                                                  : SurakartaAlphazeroReplayBuffer::Sampling::UNIFORM);
+    }
+    if (pipeline) {
+        logger->Log(" - Pipeline actors:       %d", actor_count);
+        logger->Log(" - Save interval:         %d", save_interval);
+        train_util.TrainPipelined(argv[1], iterations, actor_count, save_interval, simulation_per_move, cpuct, temperature, logger);
+    } else {
+        logger->Log(" - Games per iteration:   %d", games_per_iteration);
+        logger->Log(" - Self-play threads:     %d", self_play_threads);
+        logger->Log(" - Transposition table:   %lld", transposition_table_size);
+        train_util.UseSelfPlaySchedule(games_per_iteration, self_play_threads);
+        train_util.UseTranspositionTable(std::max<long long>(transposition_table_size, 0));
+        train_util.Train(argv[1], iterations, simulation_per_move, cpuct, temperature, logger);
+    }
 
     return 0;
 }
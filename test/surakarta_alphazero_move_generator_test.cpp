@@ -0,0 +1,13 @@
+#include <string>
+#include "surakarta_alphazero_test.h"
+
+int main() {
+    // Long games too, so that the corpus has crowded and sparse boards and many captures
+    for (const auto& position : SurakartaAlphazeroPositionCorpus::Generate(1000, 3, 300)) {
+        std::string difference;
+        if (!EXPECT(SurakartaAlphazeroMoveGenerator::CheckAgainstCore(*position.board, *position.game_info, difference))) {
+            fprintf(stderr, "The move generator disagrees with surakarta-core: %s\n", difference.c_str());
+        }
+    }
+    return SurakartaAlphazeroTest::Result();
+}
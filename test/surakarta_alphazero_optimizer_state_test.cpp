@@ -0,0 +1,84 @@
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "surakarta_alphazero_test.h"
+
+namespace {
+
+typedef SurakartaAlphazeroNeuralNetworkBase Base;
+typedef SurakartaAlphazeroNeuralNetworkFactory Factory;
+
+const std::vector<SurakartaAlphazeroPositionCorpus::Position>& Positions() {
+    static const auto positions = SurakartaAlphazeroPositionCorpus::Generate(8, 2);
+    return positions;
+}
+
+std::unique_ptr<std::vector<Base::TrainEntry>> TrainData() {
+    auto train_data = std::make_unique<std::vector<Base::TrainEntry>>();
+    for (size_t i = 0; i < Positions().size(); i++) {
+        auto input = std::make_unique<Base::NeuralNetworkInput>(SurakartaAlphazeroPositionCorpus::MakeInput(Positions()[i]));
+        auto output = std::make_unique<Base::NeuralNetworkOutput>();
+        output->move_probabilities = std::make_unique<std::vector<Base::MoveWithProbability>>();
+        for (size_t j = 0; j < input->legal_moves.size(); j++) {
+            output->move_probabilities->push_back({input->legal_moves[j], j == i % input->legal_moves.size() ? 1.0f : 0.0f});
+        }
+        output->current_status_value = i % 2 == 0 ? 1.0f : -1.0f;
+        train_data->push_back({std::move(input), std::move(output)});
+    }
+    return train_data;
+}
+
+/// @brief The priors and values of model on the test positions, to compare weights through.
+std::vector<float> Outputs(Base& model) {
+    std::vector<float> outputs;
+    for (const auto& position : Positions()) {
+        const auto output = model.Predict(SurakartaAlphazeroPositionCorpus::MakeInput(position));
+        for (const auto& move_with_probability : *output.move_probabilities) {
+            outputs.push_back(move_with_probability.probability);
+        }
+        outputs.push_back(output.current_status_value);
+    }
+    return outputs;
+}
+
+}  // namespace
+
+int main() {
+    const std::string model_path = "surakarta_alphazero_optimizer_state_test.bin";
+    const SurakartaAlphazeroNeuralNetworkArchitecture architecture{
+        SurakartaAlphazeroNeuralNetworkArchitecture::Trunk::DENSE, 64, 2,
+        SurakartaAlphazeroNeuralNetworkArchitecture::PolicyHead::DENSE,
+        SurakartaAlphazeroNeuralNetworkArchitecture::PolicyOutput::SOFTMAX};
+    Factory factory(4, 2, Factory::Backend::SCALAR, architecture);
+
+    // Training a reloaded model must continue exactly where the saved one left off
+    auto model = factory.CreateModel(model_path);
+    model->Train(TrainData());
+    model->SaveModel(model_path);
+    EXPECT(std::filesystem::exists(Factory::OptimizerStatePath(model_path)));
+    auto reloaded = factory.LoadModel(model_path);
+    EXPECT(Outputs(*reloaded) == Outputs(*model));
+    model->Train(TrainData());
+    reloaded->Train(TrainData());
+    EXPECT(Outputs(*reloaded) == Outputs(*model));
+
+    // Without the state, the moments start from zero again and the update differs
+    std::filesystem::remove(Factory::OptimizerStatePath(model_path));
+    auto restarted = factory.LoadModel(model_path);
+    restarted->Train(TrainData());
+    EXPECT(Outputs(*restarted) != Outputs(*model));
+
+    // A malformed state is an error, not a silent restart
+    {
+        std::ofstream file(Factory::OptimizerStatePath(model_path), std::ios::binary | std::ios::trunc);
+        file << "not an optimizer state";
+    }
+    bool thrown = false;
+    try {
+        factory.LoadModel(model_path);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    EXPECT(thrown);
+    return SurakartaAlphazeroTest::Result();
+}
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include "surakarta_alphazero_test.h"
+
+namespace {
+
+std::vector<int> LegalMoveIndices(const SurakartaAlphazeroPosition& position) {
+    SurakartaAlphazeroMoveGenerator::MoveList move_list;
+    SurakartaAlphazeroMoveGenerator::GenerateMoves(position, position.current_player, move_list);
+    std::vector<SurakartaMove> moves(move_list.Count());
+    move_list.Write(moves.data());
+    std::vector<int> indices;
+    for (const auto& move : moves) {
+        indices.push_back(SurakartaAlphazeroNeuralNetworkBase::MoveToIndex(move));
+    }
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+bool SamePosition(const SurakartaAlphazeroPosition& a, const SurakartaAlphazeroPosition& b) {
+    return a.black == b.black && a.white == b.white && a.num_round == b.num_round &&
+           a.last_captured_round == b.last_captured_round && a.current_player == b.current_player;
+}
+
+}  // namespace
+
+int main() {
+    EXPECT(SurakartaAlphazeroSymmetry::Inverse(0) == 0);
+    for (int symmetry = 0; symmetry < SurakartaAlphazeroSymmetry::kCount; symmetry++) {
+        const int inverse = SurakartaAlphazeroSymmetry::Inverse(symmetry);
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            for (int y = 0; y < BOARD_SIZE; y++) {
+                const SurakartaPosition cell(x, y);
+                const auto round_trip = SurakartaAlphazeroSymmetry::TransformCell(
+                    inverse, SurakartaAlphazeroSymmetry::TransformCell(symmetry, cell));
+                EXPECT(round_trip.x == x && round_trip.y == y);
+            }
+        }
+        for (int index = 0; index < SurakartaAlphazeroNeuralNetworkBase::kPolicySize; index++) {
+            EXPECT(SurakartaAlphazeroSymmetry::TransformMoveIndex(
+                       inverse, SurakartaAlphazeroSymmetry::TransformMoveIndex(symmetry, index)) == index);
+        }
+    }
+
+    for (const auto& position : SurakartaAlphazeroPositionCorpus::Generate(200, 1)) {
+        const SurakartaAlphazeroPosition original(*position.board, *position.game_info);
+        const auto legal_moves = SurakartaAlphazeroPositionCorpus::MakeInput(position).legal_moves;
+        for (int symmetry = 0; symmetry < SurakartaAlphazeroSymmetry::kCount; symmetry++) {
+            const auto transformed = SurakartaAlphazeroSymmetry::TransformPosition(symmetry, original);
+            EXPECT(SamePosition(SurakartaAlphazeroSymmetry::TransformPosition(
+                                    SurakartaAlphazeroSymmetry::Inverse(symmetry), transformed),
+                                original));
+
+            // The moves of the transformed position are the transformed moves
+            std::vector<int> transformed_moves;
+            for (const auto& move : legal_moves) {
+                const int index = SurakartaAlphazeroNeuralNetworkBase::MoveToIndex(move);
+                const auto transformed_move = SurakartaAlphazeroSymmetry::TransformMove(symmetry, move);
+                EXPECT(SurakartaAlphazeroSymmetry::TransformMoveIndex(symmetry, index) ==
+                       SurakartaAlphazeroNeuralNetworkBase::MoveToIndex(transformed_move));
+                transformed_moves.push_back(SurakartaAlphazeroNeuralNetworkBase::MoveToIndex(transformed_move));
+            }
+            std::sort(transformed_moves.begin(), transformed_moves.end());
+            EXPECT(LegalMoveIndices(transformed) == transformed_moves);
+        }
+    }
+    return SurakartaAlphazeroTest::Result();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdio>
+#include "surakarta_alphazero.h"
+
+/// @brief Check a condition in a test, reporting where it failed. main() returns SurakartaAlphazeroTest::Result().
+#define EXPECT(condition) SurakartaAlphazeroTest::Expect((condition), #condition, __FILE__, __LINE__)
+
+/// @brief Helpers shared by the test executables, which ctest runs.
+class SurakartaAlphazeroTest {
+   public:
+    static bool Expect(bool condition, const char* text, const char* file, int line) {
+        if (!condition) {
+            fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+            Failures()++;
+        }
+        return condition;
+    }
+
+    /// @return The exit code of the test: 0 if every check passed.
+    static int Result() {
+        if (Failures() > 0) {
+            fprintf(stderr, "%d checks failed\n", Failures());
+            return 1;
+        }
+        return 0;
+    }
+
+   private:
+    static int& Failures() {
+        static int failures = 0;
+        return failures;
+    }
+};